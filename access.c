@@ -0,0 +1,68 @@
+#include <stdint.h>
+#include "cpu.h"
+#include "access.h"
+
+void noteAccessSite(CPUState* state, AccessSite* site) {
+    uint8_t* code = &state->mem[state->pc];
+    site->pc = state->pc;
+    site->sp = state->sp;
+    site->bc = state->b << 8 | state->c;
+    site->de = state->d << 8 | state->e;
+    site->hl = state->h << 8 | state->l;
+    site->op[0] = code[0];
+    site->op[1] = code[1];
+    site->op[2] = code[2];
+}
+
+static inline void reads(MemAccess* acc, uint16_t addr, int n) {
+    for (int i = 0; i < n; i++)
+        acc->read[acc->reads++] = addr + i;
+}
+
+static inline void writes(MemAccess* acc, uint16_t addr, int n) {
+    for (int i = 0; i < n; i++)
+        acc->write[acc->writes++] = addr + i;
+}
+
+void decodeAccess(AccessSite* site, uint16_t spAfter, MemAccess* acc) {
+    uint8_t op = site->op[0];
+    uint16_t sp = site->sp;
+    uint16_t adr = site->op[2] << 8 | site->op[1];
+    acc->reads = 0;
+    acc->writes = 0;
+
+    if (op == 0x76) {                                       // HLT
+    } else if (op >= 0x40 && op < 0xc0 && (op & 7) == 6) {  // MOV r,M and ALU M
+        reads(acc, site->hl, 1);
+    } else if (op >= 0x70 && op < 0x78) {                   // MOV M,r
+        writes(acc, site->hl, 1);
+    } else if ((op & 0xcf) == 0xc5) {                       // PUSH
+        writes(acc, sp - 2, 2);
+    } else if ((op & 0xcf) == 0xc1) {                       // POP
+        reads(acc, sp, 2);
+    } else if ((op & 0xc7) == 0xc7 || op == 0xcd) {         // RST, CALL
+        writes(acc, sp - 2, 2);
+    } else if ((op & 0xc7) == 0xc4) {                       // Ccc
+        if (spAfter == (uint16_t) (sp - 2))
+            writes(acc, sp - 2, 2);
+    } else if (op == 0xc9) {                                // RET
+        reads(acc, sp, 2);
+    } else if ((op & 0xc7) == 0xc0) {                       // Rcc
+        if (spAfter == (uint16_t) (sp + 2))
+            reads(acc, sp, 2);
+    } else {
+        switch (op) {
+            case 0x34: case 0x35: reads(acc, site->hl, 1); writes(acc, site->hl, 1); break;   // INR M, DCR M
+            case 0x36: writes(acc, site->hl, 1); break;                                     // MVI M
+            case 0x02: writes(acc, site->bc, 1); break;                                     // STAX B
+            case 0x12: writes(acc, site->de, 1); break;                                     // STAX D
+            case 0x0a: reads(acc, site->bc, 1); break;                                      // LDAX B
+            case 0x1a: reads(acc, site->de, 1); break;                                      // LDAX D
+            case 0x32: writes(acc, adr, 1); break;                                          // STA
+            case 0x3a: reads(acc, adr, 1); break;                                           // LDA
+            case 0x22: writes(acc, adr, 2); break;                                          // SHLD
+            case 0x2a: reads(acc, adr, 2); break;                                           // LHLD
+            case 0xe3: reads(acc, sp, 2); writes(acc, sp, 2); break;                        // XTHL
+        }
+    }
+}
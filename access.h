@@ -0,0 +1,28 @@
+#ifndef __access_h__
+#define __access_h__
+
+#include <stdint.h>
+#include "cpu.h"
+
+// what an instruction's data accesses depend on, taken before it runs
+typedef struct AccessSite {
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t bc, de, hl;
+    uint8_t op[3];
+} AccessSite;
+
+// data reads and writes of one instruction, instruction fetches aren't included
+typedef struct MemAccess {
+    uint8_t reads;
+    uint8_t writes;
+    uint16_t read[2];
+    uint16_t write[2];
+} MemAccess;
+
+void    noteAccessSite(CPUState* state, AccessSite* site);
+
+// spAfter tells taken conditional calls and returns from untaken ones
+void    decodeAccess(AccessSite* site, uint16_t spAfter, MemAccess* acc);
+
+#endif
@@ -0,0 +1,534 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "machine.h"
+#include "batch.h"
+#include "memmap.h"
+
+#define ROM_END 0x2000  // below this every lane sees the same opcodes
+
+// one byte per lane, AVX2 with -mavx2, plain SSE or scalar code otherwise
+typedef uint8_t vec __attribute__((vector_size(BATCH_LANES)));
+typedef uint16_t vec16 __attribute__((vector_size(2 * BATCH_LANES), aligned(32)));
+typedef int32_t vec32 __attribute__((vector_size(4 * BATCH_LANES), aligned(32)));
+
+#define V(arr) (*(vec*) (arr))
+#define FOR_LANES(i) for (int i = 0; i < bt->lanes; i++) if (m[i])
+
+// what vectorStep did with the group
+enum { STEP_PEEL, STEP_NEXT, STEP_BRANCH };
+
+// lanes at the same pc running together, the mask widened for pc and cycles
+typedef struct Group {
+    uint8_t m[BATCH_LANES] __attribute__((aligned(32)));
+    vec16 m16;
+    vec32 m32;
+    int lead;
+    int count;
+    int32_t cycles;     // of the furthest along lane
+} Group;
+
+// writes val into the lanes set in mask, leaves the others alone
+static inline void blend(uint8_t* dst, vec val, vec mask) {
+    V(dst) = (val & mask) | (V(dst) & ~mask);
+}
+
+static inline vec splat(uint8_t x) {
+    vec v = {0};
+    return v + x;
+}
+
+static uint8_t* reg(BatchCPU* bt, int r) {
+    switch (r) {
+        case 0: return bt->b;
+        case 1: return bt->c;
+        case 2: return bt->d;
+        case 3: return bt->e;
+        case 4: return bt->h;
+        case 5: return bt->l;
+        case 7: return bt->a;
+    }
+    return NULL;    // 6 is (HL)
+}
+
+// plain pages only, runBatchHalf peels everything when the map has handlers
+static inline uint8_t laneRead(BatchCPU* bt, int i, uint16_t addr) {
+    return bt->mem[i][addr + bt->map->read[addr >> PAGE_SHIFT]];
+}
+
+static inline void laneWrite(BatchCPU* bt, int i, uint16_t addr, uint8_t val) {
+    bt->mem[i][addr + bt->map->write[addr >> PAGE_SHIFT]] = val;
+}
+
+static inline uint16_t laneHL(BatchCPU* bt, int i) {
+    return bt->h[i] << 8 | bt->l[i];
+}
+
+// register or (HL) operand of an opcode, (HL) is gathered lane by lane
+static vec operand(BatchCPU* bt, int r, uint8_t* m) {
+    if (r != 6)
+        return V(reg(bt, r));
+    vec v = {0};
+    FOR_LANES(i) v[i] = laneRead(bt, i, laneHL(bt, i));
+    return v;
+}
+
+// S, Z and P from an 8 bit result, same as aluFlags in cpu.c
+static inline void szpFlags(BatchCPU* bt, vec res, vec mask) {
+    vec zero = {0};
+    vec x = res ^ (res >> 4);
+    x ^= x >> 2;
+    x ^= x >> 1;
+    blend(bt->fz, (vec) (res == zero) & 1, mask);
+    blend(bt->fs, res >> 7, mask);
+    blend(bt->fp, (x & 1) ^ 1, mask);
+}
+
+// ADD ADC SUB SBB ANA XRA ORA CMP, carry/borrow worked out without bit 8, AC from bit 4 of aux as in cpu.c
+static void aluOp(BatchCPU* bt, int op, vec v, vec mask) {
+    vec a = V(bt->a);
+    vec zero = {0};
+    vec res, carry, aux = zero;
+    switch (op) {
+        case 0: res = a + v; carry = (vec) (res < a); aux = a ^ v ^ res; break;
+        case 1: {
+            vec t = a + v;
+            res = t + V(bt->fc);
+            carry = (vec) (t < a) | (vec) (res < t);
+            aux = a ^ v ^ res;
+        } break;
+        case 2: res = a - v; carry = (vec) (v > a); aux = ~(a ^ v ^ res); break;
+        case 3: {
+            vec t = a - v;
+            res = t - V(bt->fc);
+            carry = (vec) (v > a) | (vec) (V(bt->fc) > t);
+            aux = ~(a ^ v ^ res);
+        } break;
+        case 4: res = a & v; carry = zero; aux = (a | v) << 1; break;
+        case 5: res = a ^ v; carry = zero; break;
+        case 6: res = a | v; carry = zero; break;
+        default: res = a - v; carry = (vec) (v > a); aux = ~(a ^ v ^ res); break;
+    }
+    if (op != 7)
+        blend(bt->a, res, mask);
+    szpFlags(bt, res, mask);
+    blend(bt->fc, carry & 1, mask);
+    blend(bt->fac, (aux >> 4) & 1, mask);
+}
+
+// flag tested by a Jcc/Ccc/Rcc condition field, taken when it equals cc & 1
+static uint8_t* condFlag(BatchCPU* bt, int cc) {
+    switch (cc >> 1) {
+        case 0: return bt->fz;
+        case 1: return bt->fc;
+        case 2: return bt->fp;
+    }
+    return bt->fs;
+}
+
+static inline void lanePush(BatchCPU* bt, int i, uint16_t val) {
+    laneWrite(bt, i, bt->sp[i] - 1, val >> 8);
+    laneWrite(bt, i, bt->sp[i] - 2, val & 0xff);
+    bt->sp[i] -= 2;
+}
+
+static inline uint16_t lanePop(BatchCPU* bt, int i) {
+    uint16_t val = laneRead(bt, i, bt->sp[i] + 1) << 8 | laneRead(bt, i, bt->sp[i]);
+    bt->sp[i] += 2;
+    return val;
+}
+
+// moves pc and cycles on for the whole group
+static inline void advance(BatchCPU* bt, Group* g, int size, uint8_t op) {
+    vec16 zero16 = {0};
+    vec32 zero32 = {0};
+    *(vec16*) bt->pc += (zero16 + (uint16_t) size) & g->m16;
+    *(vec32*) bt->cycles += (zero32 + cycles8080[op]) & g->m32;
+}
+
+/*
+    Runs the opcode at code for every lane in the group. Register ops are
+    vector ops, memory and control flow loop over the lanes. Returns
+    STEP_PEEL for anything else so the caller can step the lanes one by
+    one, STEP_BRANCH when lanes may have gone different ways.
+*/
+static int vectorStep(BatchCPU* bt, Group* g, unsigned char* code) {
+    uint8_t* m = g->m;
+    vec mask = V(m);
+    uint8_t op = code[0];
+    uint16_t adr = code[2] << 8 | code[1];
+    int size = 1;
+
+    if (op >= 0x40 && op < 0x80 && op != 0x76) {                // MOV
+        int dst = (op >> 3) & 7;
+        vec v = operand(bt, op & 7, m);
+        if (dst == 6) {
+            FOR_LANES(i) laneWrite(bt, i, laneHL(bt, i), v[i]);
+        } else {
+            blend(reg(bt, dst), v, mask);
+        }
+    } else if (op >= 0x80 && op < 0xc0) {                       // ALU r
+        aluOp(bt, (op >> 3) & 7, operand(bt, op & 7, m), mask);
+    } else if ((op & 0xc7) == 0xc6) {                           // ALU d8
+        aluOp(bt, (op >> 3) & 7, splat(code[1]), mask);
+        size = 2;
+    } else if ((op & 0xc7) == 0x06) {                           // MVI
+        if (op == 0x36) {
+            FOR_LANES(i) laneWrite(bt, i, laneHL(bt, i), code[1]);
+        } else {
+            blend(reg(bt, (op >> 3) & 7), splat(code[1]), mask);
+        }
+        size = 2;
+    } else if ((op & 0xc7) == 0x04 && op != 0x34) {             // INR
+        uint8_t* r = reg(bt, (op >> 3) & 7);
+        vec res = V(r) + 1;
+        blend(r, res, mask);
+        szpFlags(bt, res, mask);
+        blend(bt->fac, (vec) ((res & 0x0f) == 0) & 1, mask);
+    } else if ((op & 0xc7) == 0x05 && op != 0x35) {             // DCR
+        uint8_t* r = reg(bt, (op >> 3) & 7);
+        vec res = V(r) - 1;
+        blend(r, res, mask);
+        szpFlags(bt, res, mask);
+        blend(bt->fac, (vec) ((res & 0x0f) != 0x0f) & 1, mask);
+    } else if ((op & 0xc7) == 0xc2) {                           // Jcc
+        uint8_t* f = condFlag(bt, (op >> 3) & 7);
+        uint8_t want = (op >> 3) & 1;
+        FOR_LANES(i) bt->pc[i] = (f[i] == want) ? adr : bt->pc[i] + 3;
+        advance(bt, g, 0, op);
+        return STEP_BRANCH;
+    } else if ((op & 0xc7) == 0xc4) {                           // Ccc
+        uint8_t* f = condFlag(bt, (op >> 3) & 7);
+        uint8_t want = (op >> 3) & 1;
+        FOR_LANES(i) {
+            if (f[i] == want) {
+                lanePush(bt, i, bt->pc[i] + 3);
+                bt->pc[i] = adr;
+            } else {
+                bt->pc[i] += 3;
+            }
+        }
+        advance(bt, g, 0, op);
+        return STEP_BRANCH;
+    } else if ((op & 0xc7) == 0xc0) {                           // Rcc
+        uint8_t* f = condFlag(bt, (op >> 3) & 7);
+        uint8_t want = (op >> 3) & 1;
+        FOR_LANES(i) bt->pc[i] = (f[i] == want) ? lanePop(bt, i) : bt->pc[i] + 1;
+        advance(bt, g, 0, op);
+        return STEP_BRANCH;
+    } else {
+        vec zero = {0};
+        switch (op) {
+            case 0x00: break;
+            case 0x01: blend(bt->b, splat(code[2]), mask); blend(bt->c, splat(code[1]), mask); size = 3; break;
+            case 0x11: blend(bt->d, splat(code[2]), mask); blend(bt->e, splat(code[1]), mask); size = 3; break;
+            case 0x21: blend(bt->h, splat(code[2]), mask); blend(bt->l, splat(code[1]), mask); size = 3; break;
+            case 0x31: FOR_LANES(i) bt->sp[i] = adr; size = 3; break;
+            case 0x03: case 0x13: case 0x23: {                  // INX, carry into the high byte
+                uint8_t* hi = reg(bt, (op >> 3) & 6);
+                uint8_t* lo = reg(bt, ((op >> 3) & 6) + 1);
+                vec res = V(lo) + 1;
+                blend(hi, V(hi) - (vec) (res == zero), mask);
+                blend(lo, res, mask);
+            } break;
+            case 0x0b: case 0x1b: case 0x2b: {                  // DCX, borrow from the high byte
+                uint8_t* hi = reg(bt, (op >> 3) & 6);
+                uint8_t* lo = reg(bt, ((op >> 3) & 6) + 1);
+                blend(hi, V(hi) + (vec) (V(lo) == zero), mask);
+                blend(lo, V(lo) - 1, mask);
+            } break;
+            case 0x33: FOR_LANES(i) bt->sp[i] += 1; break;
+            case 0x3b: FOR_LANES(i) bt->sp[i] -= 1; break;
+            case 0x0a: FOR_LANES(i) bt->a[i] = laneRead(bt, i, bt->b[i] << 8 | bt->c[i]); break;
+            case 0x1a: FOR_LANES(i) bt->a[i] = laneRead(bt, i, bt->d[i] << 8 | bt->e[i]); break;
+            case 0x02: FOR_LANES(i) laneWrite(bt, i, bt->b[i] << 8 | bt->c[i], bt->a[i]); break;
+            case 0x12: FOR_LANES(i) laneWrite(bt, i, bt->d[i] << 8 | bt->e[i], bt->a[i]); break;
+            case 0x3a: FOR_LANES(i) bt->a[i] = laneRead(bt, i, adr); size = 3; break;
+            case 0x32: FOR_LANES(i) laneWrite(bt, i, adr, bt->a[i]); size = 3; break;
+            case 0x2a: FOR_LANES(i) {
+                bt->l[i] = laneRead(bt, i, adr);
+                bt->h[i] = laneRead(bt, i, adr + 1);
+            } size = 3; break;
+            case 0x22: FOR_LANES(i) {
+                laneWrite(bt, i, adr, bt->l[i]);
+                laneWrite(bt, i, adr + 1, bt->h[i]);
+            } size = 3; break;
+            case 0x07: {                                        // RLC
+                vec msb = V(bt->a) >> 7;
+                blend(bt->a, V(bt->a) << 1 | msb, mask);
+                blend(bt->fc, msb, mask);
+            } break;
+            case 0x0f: {                                        // RRC
+                vec lsb = V(bt->a) & 1;
+                blend(bt->a, lsb << 7 | V(bt->a) >> 1, mask);
+                blend(bt->fc, lsb, mask);
+            } break;
+            case 0x17: {                                        // RAL
+                vec msb = V(bt->a) >> 7;
+                blend(bt->a, V(bt->a) << 1 | V(bt->fc), mask);
+                blend(bt->fc, msb, mask);
+            } break;
+            case 0x1f: {                                        // RAR
+                vec lsb = V(bt->a) & 1;
+                blend(bt->a, V(bt->a) >> 1 | V(bt->fc) << 7, mask);
+                blend(bt->fc, lsb, mask);
+            } break;
+            case 0x09: case 0x19: case 0x29: case 0x39: FOR_LANES(i) {  // DAD
+                uint16_t val = op == 0x39 ? bt->sp[i] : reg(bt, (op >> 3) & 6)[i] << 8 | reg(bt, ((op >> 3) & 6) + 1)[i];
+                uint32_t sum = laneHL(bt, i) + val;
+                bt->h[i] = (sum >> 8) & 0xff;
+                bt->l[i] = sum & 0xff;
+                bt->fc[i] = sum >> 16;
+            } break;
+            case 0x34: case 0x35: {                             // INR M, DCR M
+                vec res = {0};
+                FOR_LANES(i) {
+                    res[i] = laneRead(bt, i, laneHL(bt, i)) + (op == 0x34 ? 1 : -1);
+                    laneWrite(bt, i, laneHL(bt, i), res[i]);
+                }
+                szpFlags(bt, res, mask);
+                if (op == 0x34)
+                    blend(bt->fac, (vec) ((res & 0x0f) == 0) & 1, mask);
+                else
+                    blend(bt->fac, (vec) ((res & 0x0f) != 0x0f) & 1, mask);
+            } break;
+            case 0x2f: blend(bt->a, ~V(bt->a), mask); break;
+            case 0x37: blend(bt->fc, splat(1), mask); break;
+            case 0x3f: blend(bt->fc, V(bt->fc) ^ 1, mask); break;
+            case 0xeb: {                                        // XCHG
+                vec d = V(bt->d), e = V(bt->e);
+                blend(bt->d, V(bt->h), mask);
+                blend(bt->e, V(bt->l), mask);
+                blend(bt->h, d, mask);
+                blend(bt->l, e, mask);
+            } break;
+            case 0xc1: FOR_LANES(i) { uint16_t v = lanePop(bt, i); bt->b[i] = v >> 8; bt->c[i] = v & 0xff; } break;
+            case 0xd1: FOR_LANES(i) { uint16_t v = lanePop(bt, i); bt->d[i] = v >> 8; bt->e[i] = v & 0xff; } break;
+            case 0xe1: FOR_LANES(i) { uint16_t v = lanePop(bt, i); bt->h[i] = v >> 8; bt->l[i] = v & 0xff; } break;
+            case 0xc5: FOR_LANES(i) lanePush(bt, i, bt->b[i] << 8 | bt->c[i]); break;
+            case 0xd5: FOR_LANES(i) lanePush(bt, i, bt->d[i] << 8 | bt->e[i]); break;
+            case 0xe5: FOR_LANES(i) lanePush(bt, i, laneHL(bt, i)); break;
+            case 0xf1: FOR_LANES(i) {                           // POP PSW
+                uint16_t v = lanePop(bt, i);
+                bt->fc[i] = v & 1;
+                bt->fp[i] = (v >> 1) & 1;
+                bt->fac[i] = (v >> 2) & 1;
+                bt->fz[i] = (v >> 3) & 1;
+                bt->fs[i] = (v >> 4) & 1;
+                bt->a[i] = v >> 8;
+            } break;
+            case 0xf5: FOR_LANES(i) {                           // PUSH PSW
+                lanePush(bt, i, bt->a[i] << 8 | bt->fc[i] | bt->fp[i] << 1 | bt->fac[i] << 2 |
+                    bt->fz[i] << 3 | bt->fs[i] << 4);
+            } break;
+            case 0xe3: FOR_LANES(i) {                           // XTHL
+                uint16_t v = lanePop(bt, i);
+                lanePush(bt, i, laneHL(bt, i));
+                bt->h[i] = v >> 8;
+                bt->l[i] = v & 0xff;
+            } break;
+            case 0xf9: FOR_LANES(i) bt->sp[i] = laneHL(bt, i); break;
+            case 0xfb: FOR_LANES(i) bt->int_enable[i] = 1; break;
+            case 0xdb: case 0xd3: FOR_LANES(i) {                // IN, OUT against the lane's own ports
+                CPUState state;
+                state.a = bt->a[i];
+                state.ports = bt->ports[i];
+                if (op == 0xdb)
+                    bt->a[i] = machineIN(&state, code[1]);
+                else
+                    machineOUT(&state, code[1]);
+                bt->ports[i] = state.ports;
+            } size = 2; break;
+            case 0xe9:
+                FOR_LANES(i) bt->pc[i] = laneHL(bt, i);
+                advance(bt, g, 0, op);
+                return STEP_BRANCH;
+            case 0xc3:
+                FOR_LANES(i) bt->pc[i] = adr;
+                advance(bt, g, 0, op);
+                return STEP_NEXT;
+            case 0xcd:
+                FOR_LANES(i) {
+                    lanePush(bt, i, bt->pc[i] + 3);
+                    bt->pc[i] = adr;
+                }
+                advance(bt, g, 0, op);
+                return STEP_NEXT;
+            case 0xc9:
+                FOR_LANES(i) bt->pc[i] = lanePop(bt, i);
+                advance(bt, g, 0, op);
+                return STEP_BRANCH;
+            default: return STEP_PEEL;
+        }
+    }
+
+    advance(bt, g, size, op);
+    return STEP_NEXT;
+}
+
+void getLane(BatchCPU* bt, int lane, CPUState* state) {
+    state->a = bt->a[lane];
+    state->b = bt->b[lane];
+    state->c = bt->c[lane];
+    state->d = bt->d[lane];
+    state->e = bt->e[lane];
+    state->h = bt->h[lane];
+    state->l = bt->l[lane];
+    state->pc = bt->pc[lane];
+    state->sp = bt->sp[lane];
+    state->flags.c = bt->fc[lane];
+    state->flags.p = bt->fp[lane];
+    state->flags.ac = bt->fac[lane];
+    state->flags.z = bt->fz[lane];
+    state->flags.s = bt->fs[lane];
+#ifdef LAZY_FLAGS
+    state->lazy.op = LAZY_NONE;
+#endif
+    state->int_enable = bt->int_enable[lane];
+    state->stopped = bt->stopped[lane];
+    state->ports = bt->ports[lane];
+    state->mem = bt->mem[lane];
+    state->map = bt->map;
+}
+
+void setLane(BatchCPU* bt, int lane, CPUState* state) {
+    syncFlags(state);
+    bt->a[lane] = state->a;
+    bt->b[lane] = state->b;
+    bt->c[lane] = state->c;
+    bt->d[lane] = state->d;
+    bt->e[lane] = state->e;
+    bt->h[lane] = state->h;
+    bt->l[lane] = state->l;
+    bt->pc[lane] = state->pc;
+    bt->sp[lane] = state->sp;
+    bt->fc[lane] = state->flags.c;
+    bt->fp[lane] = state->flags.p;
+    bt->fac[lane] = state->flags.ac;
+    bt->fz[lane] = state->flags.z;
+    bt->fs[lane] = state->flags.s;
+    bt->int_enable[lane] = state->int_enable;
+    bt->stopped[lane] = state->stopped;
+    bt->ports[lane] = state->ports;
+    if (state->mem != bt->mem[lane])
+        memcpy(bt->mem[lane], state->mem, 0x10000);
+}
+
+BatchCPU* initializeBatch(int lanes, CPUState* init) {
+    BatchCPU* bt = aligned_alloc(32, sizeof(BatchCPU));
+    memset(bt, 0, sizeof(BatchCPU));
+    bt->lanes = lanes > BATCH_LANES ? BATCH_LANES : lanes;
+    bt->map = init->map;
+    bt->handlers = hasHandlerPages(init->map);
+    for (int i = 0; i < bt->lanes; i++) {
+        bt->mem[i] = malloc(0x10000);
+        setLane(bt, i, init);
+    }
+    return bt;
+}
+
+void freeBatch(BatchCPU* bt) {
+    for (int i = 0; i < bt->lanes; i++)
+        free(bt->mem[i]);
+    free(bt);
+}
+
+// runs a lane on its own through the interpreter
+static void peel(BatchCPU* bt, int lane) {
+    CPUState state = {0};
+    getLane(bt, lane, &state);
+    bt->cycles[lane] += stepMachine(&state);
+    setLane(bt, lane, &state);
+}
+
+static void interruptLanes(BatchCPU* bt, uint16_t addr) {
+    for (int i = 0; i < bt->lanes; i++) {
+        if (bt->int_enable[i] && !bt->stopped[i]) {
+            lanePush(bt, i, bt->pc[i]);
+            bt->pc[i] = addr;
+            bt->int_enable[i] = 0;
+        }
+    }
+}
+
+/*
+    Picks the lane that is furthest behind and groups it with every other
+    unfinished lane at the same pc. Lanes that split at a branch tend to
+    meet again in the wait-for-interrupt loop. A stopped lane would only
+    spin on its HLT, so it counts as finished.
+*/
+static int formGroup(BatchCPU* bt, Group* g) {
+    int lead = -1;
+    for (int i = 0; i < bt->lanes; i++) {
+        if (bt->cycles[i] < CYCLES_HALF_FRAME && !bt->stopped[i] && (lead < 0 || bt->cycles[i] < bt->cycles[lead]))
+            lead = i;
+    }
+    if (lead < 0)
+        return 0;
+
+    uint16_t pc = bt->pc[lead];
+    g->lead = lead;
+    g->count = 0;
+    g->cycles = 0;
+    for (int i = 0; i < BATCH_LANES; i++) {
+        int in = i < bt->lanes && bt->cycles[i] < CYCLES_HALF_FRAME && !bt->stopped[i] && bt->pc[i] == pc;
+        g->m[i] = in ? 0xff : 0;
+        g->m16[i] = in ? 0xffff : 0;
+        g->m32[i] = in ? -1 : 0;
+        if (in) {
+            g->count++;
+            if (bt->cycles[i] > g->cycles)
+                g->cycles = bt->cycles[i];
+        }
+    }
+    return 1;
+}
+
+// true if a branch sent every lane in the group to the same place
+static int stillGrouped(BatchCPU* bt, Group* g) {
+    uint8_t* m = g->m;
+    uint16_t pc = bt->pc[g->lead];
+    FOR_LANES(i) {
+        if (bt->pc[i] != pc)
+            return 0;
+    }
+    return 1;
+}
+
+// a group keeps running until it splits at a branch or a lane finishes
+static void runBatchHalf(BatchCPU* bt) {
+    Group g;
+    int grouped = 0;
+    for (;;) {
+        if (!grouped && !formGroup(bt, &g))
+            return;
+
+        uint16_t pc = bt->pc[g.lead];
+        unsigned char* code = &bt->mem[g.lead][pc];
+        uint8_t op = *code;
+        int res = pc < ROM_END && !bt->handlers ? vectorStep(bt, &g, code) : STEP_PEEL;
+        if (res == STEP_PEEL) {
+            uint8_t* m = g.m;
+            FOR_LANES(i) peel(bt, i);
+            bt->scalarSteps += g.count;
+            grouped = 0;
+            continue;
+        }
+
+        bt->vectorSteps += g.count;
+        g.cycles += cycles8080[op];
+        grouped = g.cycles < CYCLES_HALF_FRAME && (res == STEP_NEXT || stillGrouped(bt, &g));
+    }
+}
+
+void runBatchFrame(BatchCPU* bt) {
+    for (int i = 0; i < bt->lanes; i++)
+        bt->cycles[i] = 0;
+    runBatchHalf(bt);
+    interruptLanes(bt, 0x08);
+
+    for (int i = 0; i < bt->lanes; i++)
+        bt->cycles[i] -= CYCLES_HALF_FRAME;
+    runBatchHalf(bt);
+    interruptLanes(bt, 0x10);
+}
@@ -0,0 +1,56 @@
+#ifndef __batch_h__
+#define __batch_h__
+
+#include <stdint.h>
+#include "cpu.h"
+
+// lanes per batch, one 256 bit AVX2 register of bytes
+#define BATCH_LANES 32
+
+/*
+    N instances of the machine stored as structure-of-arrays, so lanes
+    sitting at the same pc can run an opcode together with vector ops.
+    Lanes that diverge are stepped one at a time through stepMachine.
+    Each lane owns its 64KB of memory, all of them share init's map.
+*/
+typedef struct BatchCPU {
+    uint8_t b[BATCH_LANES] __attribute__((aligned(32)));
+    uint8_t c[BATCH_LANES] __attribute__((aligned(32)));
+    uint8_t d[BATCH_LANES] __attribute__((aligned(32)));
+    uint8_t e[BATCH_LANES] __attribute__((aligned(32)));
+    uint8_t h[BATCH_LANES] __attribute__((aligned(32)));
+    uint8_t l[BATCH_LANES] __attribute__((aligned(32)));
+    uint8_t a[BATCH_LANES] __attribute__((aligned(32)));
+
+    // flags, one byte per lane holding 0 or 1
+    uint8_t fc[BATCH_LANES] __attribute__((aligned(32)));
+    uint8_t fp[BATCH_LANES] __attribute__((aligned(32)));
+    uint8_t fac[BATCH_LANES] __attribute__((aligned(32)));
+    uint8_t fz[BATCH_LANES] __attribute__((aligned(32)));
+    uint8_t fs[BATCH_LANES] __attribute__((aligned(32)));
+
+    uint16_t pc[BATCH_LANES] __attribute__((aligned(32)));
+    int32_t cycles[BATCH_LANES] __attribute__((aligned(32)));    // into the current half frame
+    uint16_t sp[BATCH_LANES];
+    uint8_t int_enable[BATCH_LANES];
+    uint8_t stopped[BATCH_LANES];   // CPU_* as in CPUState, a stopped lane sits out
+    struct Ports ports[BATCH_LANES];
+    uint8_t* mem[BATCH_LANES];
+    const struct MemoryMap* map;
+    int handlers;           // map has handler pages, so every step is peeled
+    int lanes;
+
+    uint64_t vectorSteps;   // lane instructions run as part of a group
+    uint64_t scalarSteps;   // lane instructions peeled off to stepMachine
+} BatchCPU;
+
+// every lane starts from a copy of init, including its memory
+BatchCPU*   initializeBatch(int lanes, CPUState* init);
+void        freeBatch(BatchCPU* batch);
+void        getLane(BatchCPU* batch, int lane, CPUState* state);
+void        setLane(BatchCPU* batch, int lane, CPUState* state);
+
+// same timing and interrupts as runFrame, for every lane
+void        runBatchFrame(BatchCPU* batch);
+
+#endif
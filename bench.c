@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "cpu.h"
+#include "machine.h"
+#include "compiled.h"
+#include "batch.h"
+#include "env.h"
+#include "rewind.h"
+#include "runahead.h"
+#include "control.h"
+#include "recorder.h"
+#include "search.h"
+#include "checkpoint.h"
+#include "screen.h"
+
+/*
+    Headless attract-mode run for timing the cores.
+
+    usage: bench [-c] [-f] [-b lanes] [-e envs] [-r interval] [-a ahead] [-s] [-w width [-t MB]] [-k every] [-p scale] [frames]
+    -c uses the recompiled backend instead of the interpreter
+    -f runs the interpreter through the crash flight recorder
+    -b runs that many instances in lockstep through the batch core
+    -e plays that many games through the env API with random actions
+    -r records every frame for rewind with a keyframe every interval frames
+    -a shows the screen from that many frames ahead through save states
+    -s steps a forked server through the shared memory control block
+    -w beam searches a second of a fresh game's inputs, that many nodes per depth
+    -t drops the search's repeated states through a transposition table of that size
+    -k checkpoints to a log file every that many frames, then restores from it
+    -p renders every frame to the coloured, upright picture at that scale
+*/
+int main(int argc, char** argv) {
+    StepFn step = stepMachine;
+    char* name = "interpreter";
+    int frames = 60 * 60;
+    int lanes = 0;
+    int envs = 0;
+    int interval = 0;
+    int ahead = -1;
+    int shared = 0;
+    int width = 0;
+    int every = 0;
+    int tableMB = 0;
+    int present = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0) {
+            step = stepCompiled;
+            name = "compiled";
+        } else if (strcmp(argv[i], "-f") == 0) {
+            startRecorder(malloc(sizeof(Recorder)), "bench-crash");
+            step = stepRecorded;
+            name = "recorded";
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            lanes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            envs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            ahead = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            shared = 1;
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            width = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tableMB = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            present = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            every = atoi(argv[++i]);
+        } else {
+            frames = atoi(argv[i]);
+        }
+    }
+
+    if (envs > 0) {
+        EnvConfig config = { .frameSkip = 4, .sticky = 0.25f, .downsample = 4, .seed = 1, .step = step };
+        Env* env = initializeEnv(envs, &config);
+        uint8_t* actions = malloc(envs);
+        int32_t* rewards = malloc(envs * sizeof(int32_t));
+        uint8_t* dones = malloc(envs);
+        uint8_t* obs = malloc(envs * envObsSize(env));
+        long total = 0, games = 0;
+
+        int steps = frames / config.frameSkip;
+        clock_t start = clock();
+        for (int s = 0; s < steps; s++) {
+            for (int i = 0; i < envs; i++)
+                actions[i] = rand() % ACTION_COUNT;
+            stepEnv(env, actions, rewards, dones);
+            observeEnv(env, obs);
+            for (int i = 0; i < envs; i++) {
+                total += rewards[i];
+                if (dones[i]) {
+                    games++;
+                    resetEnv(env, i);
+                }
+            }
+        }
+        double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+        printf("env x%d: %d steps in %.3fs, %.0f env steps/s, %ld games, %.1f points per game\n",
+            envs, steps, secs, (double) steps * envs / secs, games,
+            games ? (double) total / games : 0.0);
+        return 0;
+    }
+
+    if (width > 0) {
+        // a second of play, each child scored by playouts a second further on
+        SearchConfig config = { .width = width, .depth = 15, .frameSkip = 4, .rollouts = 4, .rolloutDepth = 15,
+            .memoryCap = 256 << 20, .tableBytes = (size_t) tableMB << 20, .seed = 1, .step = step };
+        CPUState* root = initializeCPU();
+        bootGame(root);
+        Search* search = initializeSearch(root, &config);
+        SearchResult result;
+        runSearch(search, &result);
+
+        printf("search w%d d%d x%d: %llu nodes, %llu duplicates, %llu playouts in %.3fs, %.0f playouts/s, %.0f emulated fps, score %d\n",
+            search->config.width, result.length, search->config.threads, (unsigned long long) result.nodes,
+            (unsigned long long) result.duplicates,
+            (unsigned long long) result.rollouts, result.secs, result.rollouts / result.secs,
+            result.frames / result.secs, result.score);
+        freeSearch(search);
+        return 0;
+    }
+
+    CPUState* CPU = initializeCPU();
+    if (!loadInvaders(CPU)) {
+        printf("Error: can't read the ROM from ./rom\n");
+        return 1;
+    }
+
+    if (lanes > 0) {
+        BatchCPU* batch = initializeBatch(lanes, CPU);
+        clock_t start = clock();
+        for (int i = 0; i < frames; i++)
+            runBatchFrame(batch);
+        double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+        printf("batch x%d: %d frames in %.3fs, %.0f instance fps, %.1f%% vector steps\n",
+            batch->lanes, frames, secs, (double) frames * batch->lanes / secs,
+            100.0 * batch->vectorSteps / (batch->vectorSteps + batch->scalarSteps));
+        freeBatch(batch);
+        return 0;
+    }
+
+    if (interval > 0) {
+        Rewind* rw = initializeRewind(64 << 20, frames, interval);
+        clock_t start = clock();
+        for (int i = 0; i < frames; i++) {
+            runFrameWith(CPU, step);
+            rewindPush(rw, CPU);
+        }
+        double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+        double perFrame = (double) rewindUsage(rw) / (rewindNewest(rw) - rewindOldest(rw) + 1);
+
+        // walk back through the window, each restore drops the frames after it
+        int restores = 0;
+        start = clock();
+        for (uint64_t f = rewindNewest(rw); f > rewindOldest(rw) + 7; f -= 7) {
+            rewindTo(rw, f, CPU);
+            restores++;
+        }
+        double restoreSecs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+        printf("rewind /%d: %d frames in %.3fs, %.0f bytes per frame, %.1fMB for 10 minutes, %.1fus per restore\n",
+            interval, frames, secs, perFrame, perFrame * FRAME_HZ * 600 / (1 << 20),
+            restores ? restoreSecs * 1e6 / restores : 0.0);
+        return 0;
+    }
+
+    if (ahead >= 0) {
+        RunAhead ra;
+        initializeRunAhead(&ra, ahead);
+        clock_t start = clock();
+        for (int i = 0; i < frames; i++)
+            runAheadFrame(CPU, &ra, step);
+        double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+        printf("run-ahead %d: %d frames in %.3fs, %.0f shown fps, %.1fx realtime\n",
+            ra.frames, frames, secs, frames / secs, frames / (secs * FRAME_HZ));
+        return 0;
+    }
+
+    if (every > 0) {
+        char path[64];
+        snprintf(path, sizeof(path), "bench-%d.ckpt", getpid());
+        Checkpoints* ck = createCheckpoints(path, 8);
+        if (ck == NULL) {
+            printf("Error: can't create %s\n", path);
+            return 1;
+        }
+
+        // the worst queue call is what the frame loop would feel
+        struct timespec t0, t1, q0, q1;
+        double worst = 0, queued = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int i = 1; i <= frames; i++) {
+            runFrameWith(CPU, step);
+            if (i % every == 0) {
+                clock_gettime(CLOCK_MONOTONIC, &q0);
+                queueCheckpoint(ck, CPU, 0, i);
+                clock_gettime(CLOCK_MONOTONIC, &q1);
+                double q = (q1.tv_sec - q0.tv_sec) + (q1.tv_nsec - q0.tv_nsec) / 1e9;
+                worst = q > worst ? q : worst;
+                queued += q;
+            }
+        }
+        int uring = ck->uring;
+        uint64_t count = ck->count, waits = ck->waits;
+        if (!closeCheckpoints(ck)) {
+            printf("Error: can't write checkpoints to %s\n", path);
+            return 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+        CheckpointLog* log = openCheckpointLog(path);
+        int restores = 0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int f = frames; f > 0; f -= 7 * every)
+            restores += readCheckpoint(log, findCheckpoint(log, 0, f), CPU);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double restoreSecs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        closeCheckpointLog(log);
+        unlink(path);
+
+        printf("checkpoint /%d (%s): %llu in %.3fs with the frames, %.0f fps, %.1fus mean and %.1fus worst queue, %llu waits, %.1fus per restore\n",
+            every, uring ? "io_uring" : "thread", (unsigned long long) count, secs, frames / secs,
+            count ? queued * 1e6 / count : 0.0, worst * 1e6,
+            (unsigned long long) waits, restores ? restoreSecs * 1e6 / restores : 0.0);
+        return 0;
+    }
+
+    if (present > 0) {
+        Screen screen;
+        initializeScreen(&screen, present, 1);
+        int pitch = screen.width * sizeof(uint32_t);
+        uint32_t* pixels = malloc((size_t) pitch * screen.height);
+        double secs = 0;
+        for (int i = 0; i < frames; i++) {
+            runFrameWith(CPU, step);
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            renderScreen(&screen, &CPU->mem[VRAM_START], pixels, pitch);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            secs += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        }
+        free(pixels);
+
+        printf("present %dx: %d frames of %dx%d in %.3fs, %.1fus per frame\n",
+            screen.scale, frames, screen.width, screen.height, secs, secs * 1e6 / frames);
+        return 0;
+    }
+
+    if (shared) {
+        char shm[64];
+        snprintf(shm, sizeof(shm), "/invaders-bench-%d", getpid());
+        Control* server = createControl(shm);
+        if (server == NULL) {
+            printf("Error: can't create shared memory %s\n", shm);
+            return 1;
+        }
+        pid_t child = fork();
+        if (child == 0) {
+            serveControl(server, CPU, step);
+            return 0;
+        }
+
+        // wall time, the work happens in the other process
+        Control* ctl = attachControl(shm);
+        struct timespec t0, t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int i = 0; i < frames; i++)
+            controlStep(ctl, 0x08, 0, 0);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        for (int i = 0; i < frames; i++)
+            controlStep(ctl, 0x08, 0, 1);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        uint64_t served = ctl->block->frame;
+        controlQuit(ctl);
+        waitpid(child, NULL, 0);
+        closeControl(ctl);
+        closeControl(server);
+
+        double empty = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        double stepped = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+        printf("shared memory: %llu frames in %.3fs, %.0f steps/s, %.1fus round trip with no frames\n",
+            (unsigned long long) served, stepped, frames / stepped, empty * 1e6 / frames);
+        return 0;
+    }
+
+    clock_t start = clock();
+    for (int i = 0; i < frames; i++)
+        runFrameWith(CPU, step);
+    double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%s: %d frames in %.3fs, %.0f fps, %.1f emulated MHz, %.1fx realtime\n",
+        name, frames, secs, frames / secs,
+        (double) frames * CYCLES_FRAME / secs / 1e6,
+        frames / (secs * FRAME_HZ));
+    return 0;
+}
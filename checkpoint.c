@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "cpu.h"
+#include "machine.h"
+#include "checkpoint.h"
+
+#define RECORD_MAGIC "CKPT"
+
+typedef struct IndexTrailer {
+    uint64_t count;
+    uint64_t offset;
+    char magic[8];
+} IndexTrailer;
+
+// FNV-1a over 64 bit words, folded, SaveState is a whole number of them
+static uint32_t checksum(const void* data, size_t size) {
+    const uint64_t* w = data;
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size / 8; i++)
+        h = (h ^ w[i]) * 0x100000001b3ull;
+    return h ^ (h >> 32);
+}
+
+static uint8_t* slotAt(Checkpoints* ck, uint64_t seq) {
+    return ck->slots + (seq % CHECKPOINT_SLOTS) * CHECKPOINT_RECORD;
+}
+
+// frees the slots at the head that have been written, they complete out of order
+static void retire(Checkpoints* ck) {
+    while (ck->head < ck->submitted && ck->written[ck->head % CHECKPOINT_SLOTS]) {
+        ck->written[ck->head % CHECKPOINT_SLOTS] = 0;
+        ck->head++;
+    }
+}
+
+/*
+    io_uring through raw syscalls, there's no liburing here. Needs
+    IORING_OP_WRITE, so kernels older than 5.6 (no IORING_FEAT_RW_CUR_POS)
+    get the writer thread instead.
+*/
+static int setupRing(Checkpoints* ck) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int ring = syscall(__NR_io_uring_setup, CHECKPOINT_SLOTS, &p);
+    if (ring < 0)
+        return 0;
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+        close(ring);
+        return 0;
+    }
+
+    ck->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    ck->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ck->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    ck->sqRing = mmap(NULL, ck->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    ck->cqRing = mmap(NULL, ck->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+    ck->sqes = mmap(NULL, ck->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    if (ck->sqRing == MAP_FAILED || ck->cqRing == MAP_FAILED || ck->sqes == MAP_FAILED) {
+        if (ck->sqRing != MAP_FAILED)
+            munmap(ck->sqRing, ck->sqRingSize);
+        if (ck->cqRing != MAP_FAILED)
+            munmap(ck->cqRing, ck->cqRingSize);
+        if (ck->sqes != MAP_FAILED)
+            munmap(ck->sqes, ck->sqesSize);
+        close(ring);
+        return 0;
+    }
+
+    uint8_t* sq = ck->sqRing;
+    uint8_t* cq = ck->cqRing;
+    ck->sqHead = (uint32_t*) (sq + p.sq_off.head);
+    ck->sqTail = (uint32_t*) (sq + p.sq_off.tail);
+    ck->sqMask = *(uint32_t*) (sq + p.sq_off.ring_mask);
+    ck->sqArray = (uint32_t*) (sq + p.sq_off.array);
+    ck->cqHead = (uint32_t*) (cq + p.cq_off.head);
+    ck->cqTail = (uint32_t*) (cq + p.cq_off.tail);
+    ck->cqMask = *(uint32_t*) (cq + p.cq_off.ring_mask);
+    ck->cqes = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+    ck->ring = ring;
+    return 1;
+}
+
+// the submission queue holds CHECKPOINT_SLOTS, so it can't fill up
+static void submitRing(Checkpoints* ck) {
+    uint32_t tail = *ck->sqTail;
+    int n = 0;
+    for (; ck->submitted < ck->tail; ck->submitted++, n++) {
+        uint32_t i = tail & ck->sqMask;
+        struct io_uring_sqe* sqe = &ck->sqes[i];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->flags = IOSQE_ASYNC;         // to a kernel worker, buffered writes would copy inline
+        sqe->fd = ck->fd;
+        sqe->addr = (uint64_t) (uintptr_t) slotAt(ck, ck->submitted);
+        sqe->len = CHECKPOINT_RECORD;
+        sqe->off = ck->slotOffset[ck->submitted % CHECKPOINT_SLOTS];
+        sqe->user_data = ck->submitted;
+        ck->sqArray[i] = i;
+        tail++;
+    }
+    atomic_store_explicit((_Atomic uint32_t*) ck->sqTail, tail, memory_order_release);
+    if (n > 0 && syscall(__NR_io_uring_enter, ck->ring, n, 0, 0, NULL, 0) < 0)
+        ck->failed = 1;
+    ck->submits++;
+}
+
+static void reapRing(Checkpoints* ck, int wait) {
+    if (wait)
+        syscall(__NR_io_uring_enter, ck->ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    uint32_t head = *ck->cqHead;
+    uint32_t tail = atomic_load_explicit((_Atomic uint32_t*) ck->cqTail, memory_order_acquire);
+    for (; head != tail; head++) {
+        struct io_uring_cqe* cqe = &ck->cqes[head & ck->cqMask];
+        if (cqe->res != (int32_t) CHECKPOINT_RECORD)
+            ck->failed = 1;
+        ck->written[cqe->user_data % CHECKPOINT_SLOTS] = 1;
+    }
+    atomic_store_explicit((_Atomic uint32_t*) ck->cqHead, head, memory_order_release);
+    retire(ck);
+}
+
+// writes submitted slots in order, the pwrite is done outside the lock
+static void* writerThread(void* arg) {
+    Checkpoints* ck = arg;
+    uint64_t seq = 0;
+    pthread_mutex_lock(&ck->lock);
+    for (;;) {
+        while (seq == ck->submitted && !ck->closing)
+            pthread_cond_wait(&ck->work, &ck->lock);
+        if (seq == ck->submitted)
+            break;
+        uint64_t offset = ck->slotOffset[seq % CHECKPOINT_SLOTS];
+        pthread_mutex_unlock(&ck->lock);
+
+        int ok = pwrite(ck->fd, slotAt(ck, seq), CHECKPOINT_RECORD, offset) == (ssize_t) CHECKPOINT_RECORD;
+
+        pthread_mutex_lock(&ck->lock);
+        if (!ok)
+            ck->failed = 1;
+        ck->written[seq % CHECKPOINT_SLOTS] = 1;
+        seq++;
+        pthread_cond_signal(&ck->done);
+    }
+    pthread_mutex_unlock(&ck->lock);
+    return NULL;
+}
+
+static void submit(Checkpoints* ck) {
+    if (ck->submitted == ck->tail)
+        return;
+    if (ck->uring) {
+        submitRing(ck);
+        return;
+    }
+    pthread_mutex_lock(&ck->lock);
+    ck->submitted = ck->tail;
+    ck->submits++;
+    pthread_cond_signal(&ck->work);
+    pthread_mutex_unlock(&ck->lock);
+}
+
+static void reap(Checkpoints* ck, int wait) {
+    if (ck->uring) {
+        reapRing(ck, wait);
+        return;
+    }
+    pthread_mutex_lock(&ck->lock);
+    retire(ck);
+    while (wait && ck->head < ck->submitted && !ck->written[ck->head % CHECKPOINT_SLOTS]) {
+        pthread_cond_wait(&ck->done, &ck->lock);
+        retire(ck);
+    }
+    pthread_mutex_unlock(&ck->lock);
+}
+
+Checkpoints* createCheckpoints(const char* path, int batch) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return NULL;
+
+    uint8_t header[CHECKPOINT_BLOCK] = {0};
+    uint32_t sizes[2] = { CHECKPOINT_RECORD, sizeof(SaveState) };
+    memcpy(header, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    memcpy(header + 8, sizes, sizeof(sizes));
+    if (pwrite(fd, header, sizeof(header), 0) != sizeof(header)) {
+        close(fd);
+        return NULL;
+    }
+
+    Checkpoints* ck = calloc(1, sizeof(Checkpoints));
+    ck->fd = fd;
+    ck->batch = batch < 1 ? 1 : batch > CHECKPOINT_SLOTS ? CHECKPOINT_SLOTS : batch;
+    ck->next = CHECKPOINT_BLOCK;
+    ck->slots = aligned_alloc(CHECKPOINT_BLOCK, CHECKPOINT_SLOTS * CHECKPOINT_RECORD);
+    memset(ck->slots, 0, CHECKPOINT_SLOTS * CHECKPOINT_RECORD);
+    ck->capacity = 1024;
+    ck->index = malloc(ck->capacity * sizeof(CheckpointEntry));
+
+    ck->uring = setupRing(ck);
+    if (!ck->uring) {
+        pthread_mutex_init(&ck->lock, NULL);
+        pthread_cond_init(&ck->work, NULL);
+        pthread_cond_init(&ck->done, NULL);
+        pthread_create(&ck->thread, NULL, writerThread, ck);
+    }
+    return ck;
+}
+
+void queueCheckpoint(Checkpoints* ck, CPUState* state, uint32_t instance, uint64_t frame) {
+    reap(ck, 0);
+    if (ck->tail - ck->head == CHECKPOINT_SLOTS) {
+        ck->waits++;
+        submit(ck);
+        while (ck->tail - ck->head == CHECKPOINT_SLOTS)
+            reap(ck, 1);
+    }
+
+    // the slot is free until tail moves past it and it's submitted
+    uint8_t* record = slotAt(ck, ck->tail);
+    RecordHeader* header = (RecordHeader*) record;
+    SaveState* save = (SaveState*) (record + sizeof(RecordHeader));
+    saveState(state, save);
+    memcpy(header->magic, RECORD_MAGIC, 4);
+    header->instance = instance;
+    header->frame = frame;
+    header->size = sizeof(SaveState);
+    header->checksum = checksum(save, sizeof(SaveState));
+
+    if (ck->count == ck->capacity) {
+        ck->capacity *= 2;
+        ck->index = realloc(ck->index, ck->capacity * sizeof(CheckpointEntry));
+    }
+    ck->index[ck->count++] = (CheckpointEntry) { instance, 0, frame, ck->next };
+    ck->slotOffset[ck->tail % CHECKPOINT_SLOTS] = ck->next;
+    ck->next += CHECKPOINT_RECORD;
+    ck->tail++;
+
+    if (ck->tail - ck->submitted >= (uint64_t) ck->batch)
+        submit(ck);
+}
+
+void flushCheckpoints(Checkpoints* ck) {
+    submit(ck);
+    while (ck->head < ck->tail)
+        reap(ck, 1);
+}
+
+int closeCheckpoints(Checkpoints* ck) {
+    flushCheckpoints(ck);
+
+    IndexTrailer trailer = { ck->count, ck->next, CHECKPOINT_INDEX_MAGIC };
+    size_t bytes = ck->count * sizeof(CheckpointEntry);
+    int ok = !ck->failed &&
+        pwrite(ck->fd, ck->index, bytes, ck->next) == (ssize_t) bytes &&
+        pwrite(ck->fd, &trailer, sizeof(trailer), ck->next + bytes) == sizeof(trailer) &&
+        fdatasync(ck->fd) == 0;
+
+    if (ck->uring) {
+        munmap(ck->sqes, ck->sqesSize);
+        munmap(ck->cqRing, ck->cqRingSize);
+        munmap(ck->sqRing, ck->sqRingSize);
+        close(ck->ring);
+    } else {
+        pthread_mutex_lock(&ck->lock);
+        ck->closing = 1;
+        pthread_cond_signal(&ck->work);
+        pthread_mutex_unlock(&ck->lock);
+        pthread_join(ck->thread, NULL);
+        pthread_mutex_destroy(&ck->lock);
+        pthread_cond_destroy(&ck->work);
+        pthread_cond_destroy(&ck->done);
+    }
+    close(ck->fd);
+    free(ck->slots);
+    free(ck->index);
+    free(ck);
+    return ok;
+}
+
+// rebuilds the index of a log that wasn't closed, stopping at the first torn record
+static void scanLog(CheckpointLog* log, uint64_t size) {
+    uint64_t capacity = 1024;
+    log->index = malloc(capacity * sizeof(CheckpointEntry));
+    for (uint64_t offset = CHECKPOINT_BLOCK; offset + CHECKPOINT_RECORD <= size; offset += CHECKPOINT_RECORD) {
+        RecordHeader h;
+        if (pread(log->fd, &h, sizeof(h), offset) != sizeof(h) || memcmp(h.magic, RECORD_MAGIC, 4) != 0 ||
+            h.size != sizeof(SaveState))
+            break;
+        if (log->count == capacity) {
+            capacity *= 2;
+            log->index = realloc(log->index, capacity * sizeof(CheckpointEntry));
+        }
+        log->index[log->count++] = (CheckpointEntry) { h.instance, 0, h.frame, offset };
+    }
+}
+
+CheckpointLog* openCheckpointLog(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    uint8_t header[16];
+    uint32_t sizes[2];
+    struct stat st;
+    if (fstat(fd, &st) < 0 || pread(fd, header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+        close(fd);
+        return NULL;
+    }
+    memcpy(sizes, header + 8, sizeof(sizes));
+    if (sizes[0] != CHECKPOINT_RECORD || sizes[1] != sizeof(SaveState)) {
+        close(fd);
+        return NULL;
+    }
+
+    CheckpointLog* log = calloc(1, sizeof(CheckpointLog));
+    log->fd = fd;
+    uint64_t size = st.st_size;
+    IndexTrailer trailer;
+    int indexed = size >= CHECKPOINT_BLOCK + sizeof(trailer) &&
+        pread(fd, &trailer, sizeof(trailer), size - sizeof(trailer)) == sizeof(trailer) &&
+        memcmp(trailer.magic, CHECKPOINT_INDEX_MAGIC, sizeof(CHECKPOINT_INDEX_MAGIC)) == 0 &&
+        trailer.offset + trailer.count * sizeof(CheckpointEntry) + sizeof(trailer) == size;
+    if (indexed) {
+        size_t bytes = trailer.count * sizeof(CheckpointEntry);
+        log->index = malloc(bytes ? bytes : 1);
+        log->count = trailer.count;
+        indexed = pread(fd, log->index, bytes, trailer.offset) == (ssize_t) bytes;
+        if (!indexed) {
+            free(log->index);
+            log->count = 0;
+        }
+    }
+    if (!indexed)
+        scanLog(log, size);
+    return log;
+}
+
+void closeCheckpointLog(CheckpointLog* log) {
+    close(log->fd);
+    free(log->index);
+    free(log);
+}
+
+int64_t findCheckpoint(CheckpointLog* log, uint32_t instance, uint64_t frame) {
+    int64_t best = -1;
+    for (uint64_t i = 0; i < log->count; i++) {
+        CheckpointEntry* e = &log->index[i];
+        if (e->instance == instance && e->frame <= frame && (best < 0 || e->frame >= log->index[best].frame))
+            best = i;
+    }
+    return best;
+}
+
+int readCheckpoint(CheckpointLog* log, uint64_t i, CPUState* state) {
+    if (i >= log->count)
+        return 0;
+    CheckpointEntry* e = &log->index[i];
+    uint8_t* record = malloc(CHECKPOINT_RECORD);
+    RecordHeader* header = (RecordHeader*) record;
+    SaveState* save = (SaveState*) (record + sizeof(RecordHeader));
+    int ok = pread(log->fd, record, CHECKPOINT_RECORD, e->offset) == (ssize_t) CHECKPOINT_RECORD &&
+        memcmp(header->magic, RECORD_MAGIC, 4) == 0 && header->instance == e->instance &&
+        header->frame == e->frame && header->checksum == checksum(save, sizeof(SaveState));
+    if (ok)
+        loadState(state, save);
+    free(record);
+    return ok;
+}
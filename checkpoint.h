@@ -0,0 +1,119 @@
+#ifndef __checkpoint_h__
+#define __checkpoint_h__
+
+#include <stdint.h>
+#include <pthread.h>
+#include "cpu.h"
+#include "machine.h"
+
+#define CHECKPOINT_MAGIC "SICKPT1"
+#define CHECKPOINT_INDEX_MAGIC "SIINDEX"
+#define CHECKPOINT_SLOTS 64         // serialized states buffered ahead of the disk
+#define CHECKPOINT_BLOCK 4096
+
+/*
+    One record per checkpoint, all the same size and block aligned:
+    a RecordHeader then the SaveState, padded to CHECKPOINT_RECORD.
+*/
+typedef struct RecordHeader {
+    char magic[4];                  // "CKPT"
+    uint32_t instance;
+    uint64_t frame;
+    uint32_t size;                  // sizeof(SaveState) of the writer
+    uint32_t checksum;              // FNV-1a of the SaveState bytes
+} RecordHeader;
+
+#define CHECKPOINT_RECORD ((sizeof(RecordHeader) + sizeof(SaveState) + CHECKPOINT_BLOCK - 1) / CHECKPOINT_BLOCK * CHECKPOINT_BLOCK)
+
+typedef struct CheckpointEntry {
+    uint32_t instance;
+    uint32_t pad;
+    uint64_t frame;
+    uint64_t offset;
+} CheckpointEntry;
+
+/*
+    Appends save states of any number of instances to one log file. The
+    caller only serializes into a preallocated slot; slots go to the
+    kernel in batches as io_uring writes, or to a writer thread doing
+    pwrite when io_uring isn't available, and are reused once written.
+    Only a full set of CHECKPOINT_SLOTS in flight makes the caller wait.
+
+    File layout: a CHECKPOINT_BLOCK header holding CHECKPOINT_MAGIC, then
+    records back to back, and on close the index, an array of
+    CheckpointEntry, followed by its count, its offset and
+    CHECKPOINT_INDEX_MAGIC. A log that was never closed is indexed by
+    scanning its records.
+*/
+typedef struct Checkpoints {
+    int fd;
+    int batch;                      // records gathered before a submit
+    int uring;                      // 0 when the writer thread does the I/O
+    uint8_t* slots;                 // CHECKPOINT_SLOTS records, block aligned
+    uint64_t head;                  // oldest slot not yet written
+    uint64_t submitted;             // slots handed to the kernel or the thread
+    uint64_t tail;                  // next slot to fill
+    uint8_t written[CHECKPOINT_SLOTS];
+    uint64_t slotOffset[CHECKPOINT_SLOTS];
+    uint64_t next;                  // file offset of the next record
+
+    CheckpointEntry* index;
+    uint64_t count;
+    uint64_t capacity;
+
+    // io_uring, mapped rings
+    int ring;
+    uint32_t* sqHead;
+    uint32_t* sqTail;
+    uint32_t sqMask;
+    uint32_t* sqArray;
+    struct io_uring_sqe* sqes;
+    uint32_t* cqHead;
+    uint32_t* cqTail;
+    uint32_t cqMask;
+    struct io_uring_cqe* cqes;
+    void* sqRing;
+    void* cqRing;
+    size_t sqRingSize, cqRingSize, sqesSize;
+
+    // writer thread fallback
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;            // slots were submitted or closing was set
+    pthread_cond_t done;            // a slot was written
+    int closing;
+
+    uint64_t waits;                 // times every slot was in flight
+    uint64_t submits;
+    int failed;                     // a write came back short
+} Checkpoints;
+
+// NULL if path can't be created, batch is clamped to 1..CHECKPOINT_SLOTS
+Checkpoints*    createCheckpoints(const char* path, int batch);
+
+// copies state into a slot, waiting only if every slot is still in flight
+void            queueCheckpoint(Checkpoints* ck, CPUState* state, uint32_t instance, uint64_t frame);
+
+// submits what's gathered and waits until it's all written
+void            flushCheckpoints(Checkpoints* ck);
+
+// flushes, appends the index and closes, returns 0 if any write failed
+int             closeCheckpoints(Checkpoints* ck);
+
+typedef struct CheckpointLog {
+    int fd;
+    CheckpointEntry* index;
+    uint64_t count;
+} CheckpointLog;
+
+// NULL if path isn't a checkpoint log from a build with the same SaveState
+CheckpointLog*  openCheckpointLog(const char* path);
+void            closeCheckpointLog(CheckpointLog* log);
+
+// latest checkpoint of instance at or before frame, -1 if there is none
+int64_t         findCheckpoint(CheckpointLog* log, uint32_t instance, uint64_t frame);
+
+// one read of index entry i into state, returns 0 if it's damaged
+int             readCheckpoint(CheckpointLog* log, uint64_t i, CPUState* state);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef __compiled_h__
+#define __compiled_h__
+
+#include "cpu.h"
+
+// ahead-of-time translation of the invaders ROM, generated by recompile
+
+extern const int compiledBlocks;
+
+// runs the basic block at pc, or interprets one instruction if there's no
+// block for it. Returns clock cycles taken, same contract as stepMachine
+int     stepCompiled(CPUState* state);
+
+#endif
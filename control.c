@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "cpu.h"
+#include "machine.h"
+#include "control.h"
+
+// not FUTEX_PRIVATE, the words are shared with another process
+static void futexWait(atomic_uint* word, unsigned value) {
+    syscall(SYS_futex, word, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+static void futexWake(atomic_uint* word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+// sleeps until word moves off value, rechecking since wakeups can be spurious
+static unsigned waitChange(atomic_uint* word, unsigned value) {
+    unsigned now;
+    while ((now = atomic_load(word)) == value)
+        futexWait(word, value);
+    return now;
+}
+
+static Control* mapControl(const char* name, int flags) {
+    int fd = shm_open(name, flags, 0600);
+    if (fd < 0)
+        return NULL;
+    if ((flags & O_CREAT) && ftruncate(fd, sizeof(ControlBlock)) < 0) {
+        close(fd);
+        return NULL;
+    }
+    void* block = mmap(NULL, sizeof(ControlBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (block == MAP_FAILED)
+        return NULL;
+
+    Control* ctl = calloc(1, sizeof(Control));
+    ctl->block = block;
+    snprintf(ctl->name, sizeof(ctl->name), "%s", name);
+    ctl->owner = (flags & O_CREAT) != 0;
+    return ctl;
+}
+
+Control* createControl(const char* name) {
+    Control* ctl = mapControl(name, O_RDWR | O_CREAT | O_TRUNC);
+    if (ctl == NULL)
+        return NULL;
+    ControlBlock* b = ctl->block;
+    memset(b, 0, sizeof(ControlBlock));
+    b->version = CONTROL_VERSION;
+    // agents check magic last, the rest is valid once it appears
+    atomic_thread_fence(memory_order_release);
+    b->magic = CONTROL_MAGIC;
+    return ctl;
+}
+
+static void observe(ControlBlock* b, CPUState* state, uint64_t frame) {
+    memcpy(b->ram, &state->mem[RAM_START], sizeof(b->ram));
+    memcpy(b->vram, &state->mem[VRAM_START], VRAM_SIZE);
+    b->sound3 = state->ports.write3;
+    b->sound5 = state->ports.write5;
+    b->frame = frame;
+}
+
+void serveControl(Control* ctl, CPUState* state, StepFn step) {
+    ControlBlock* b = ctl->block;
+    SaveState start;
+    saveState(state, &start);
+    uint64_t frame = 0;
+    // from done, a request sent before the server got here still counts
+    unsigned seen = atomic_load(&b->done);
+
+    observe(b, state, frame);
+    for (;;) {
+        seen = waitChange(&b->request, seen);
+
+        uint32_t command = b->command;
+        if (command == CONTROL_STEP) {
+            state->ports.read1 = b->input1;
+            state->ports.read2 = b->input2;
+            for (uint32_t i = 0; i < b->frames; i++)
+                runFrameWith(state, step);
+            frame += b->frames;
+        } else if (command == CONTROL_RESET) {
+            loadState(state, &start);
+            frame = 0;
+        }
+        observe(b, state, frame);
+
+        atomic_store(&b->done, seen);
+        futexWake(&b->done);
+        if (command == CONTROL_QUIT)
+            return;
+    }
+}
+
+Control* attachControl(const char* name) {
+    Control* ctl = mapControl(name, O_RDWR);
+    if (ctl == NULL)
+        return NULL;
+    if (ctl->block->magic != CONTROL_MAGIC || ctl->block->version != CONTROL_VERSION) {
+        closeControl(ctl);
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    return ctl;
+}
+
+static void send(Control* ctl, uint32_t command) {
+    ControlBlock* b = ctl->block;
+    b->command = command;
+    unsigned request = atomic_load(&b->request) + 1;
+    atomic_store(&b->request, request);
+    futexWake(&b->request);
+
+    unsigned done = atomic_load(&b->done);
+    while (done != request)
+        done = waitChange(&b->done, done);
+}
+
+void controlStep(Control* ctl, uint8_t input1, uint8_t input2, uint32_t frames) {
+    ctl->block->input1 = input1;
+    ctl->block->input2 = input2;
+    ctl->block->frames = frames;
+    send(ctl, CONTROL_STEP);
+}
+
+void controlReset(Control* ctl) {
+    send(ctl, CONTROL_RESET);
+}
+
+void controlQuit(Control* ctl) {
+    send(ctl, CONTROL_QUIT);
+}
+
+void closeControl(Control* ctl) {
+    munmap(ctl->block, sizeof(ControlBlock));
+    if (ctl->owner)
+        shm_unlink(ctl->name);
+    free(ctl);
+}
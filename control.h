@@ -0,0 +1,67 @@
+#ifndef __control_h__
+#define __control_h__
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "cpu.h"
+#include "machine.h"
+
+#define CONTROL_MAGIC 0x53494354    // "SICT"
+#define CONTROL_VERSION 1
+
+enum {
+    CONTROL_STEP,       // run frames with input1/input2 held
+    CONTROL_RESET,      // back to the state the server started from
+    CONTROL_QUIT        // server exits after acknowledging
+};
+
+/*
+    Lives in a POSIX shared memory segment so an agent in another process
+    can drive the machine without sockets or serialization. The agent
+    fills in a command and bumps request, the server runs it, refreshes
+    the observation and sets done to the same value. Both counters are
+    futex words, so either side sleeps in the kernel until the other
+    wakes it. ram and vram are contiguous and together mirror 0x2000-0x3fff.
+*/
+typedef struct ControlBlock {
+    uint32_t magic;
+    uint32_t version;
+
+    atomic_uint request;        // bumped by the agent once the command is written
+    atomic_uint done;           // set to request by the server once the results are written
+
+    // command, written by the agent
+    uint32_t command;
+    uint32_t frames;            // frames to run for CONTROL_STEP, 0 only refreshes the observation
+    uint8_t input1;             // port 1 and 2 bits held while stepping
+    uint8_t input2;
+
+    // observation, written by the server
+    uint8_t sound3;             // sound latches on ports 3 and 5
+    uint8_t sound5;
+    uint64_t frame;             // frames run since start or the last reset
+    uint8_t ram[VRAM_START - RAM_START] __attribute__((aligned(64)));
+    uint8_t vram[VRAM_SIZE];
+} ControlBlock;
+
+typedef struct Control {
+    ControlBlock* block;
+    char name[64];
+    int owner;                  // created the segment, unlinks it on close
+} Control;
+
+// server side, name is a shm_open name such as "/invaders"
+Control*    createControl(const char* name);
+// serves commands until CONTROL_QUIT, stepping with step
+void        serveControl(Control* ctl, CPUState* state, StepFn step);
+
+// agent side
+Control*    attachControl(const char* name);
+// runs frames with the inputs and blocks until the observation is updated
+void        controlStep(Control* ctl, uint8_t input1, uint8_t input2, uint32_t frames);
+void        controlReset(Control* ctl);
+void        controlQuit(Control* ctl);
+
+void        closeControl(Control* ctl);
+
+#endif
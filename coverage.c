@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "machine.h"
+#include "memmap.h"
+#include "disassembler.h"
+#include "access.h"
+#include "coverage.h"
+
+#define ROM_SIZE 0x2000
+
+static Coverage* active;
+
+void startCoverage(Coverage* cov) {
+    active = cov;
+}
+
+static inline void countRead(Coverage* cov, uint16_t addr) {
+    cov->reads[addr]++;
+    if (addr < RAM_START)
+        cov->romReads++;
+    else if (addr < VRAM_START)
+        cov->ramReads++;
+    else
+        cov->vramReads++;
+}
+
+static inline void countWrite(Coverage* cov, uint16_t addr) {
+    cov->writes[addr]++;
+    if (addr >= VRAM_START)
+        cov->vramWrites++;
+    else if (addr >= RAM_START)
+        cov->ramWrites++;
+}
+
+// addresses come from the registers before the step, see decodeAccess, and are
+// counted at their home address so a mirror's traffic lands on the RAM it repeats
+int stepCoverage(CPUState* state) {
+    Coverage* cov = active;
+    AccessSite site;
+    noteAccessSite(state, &site);
+
+    int cycles = stepMachine(state);
+    if (cov == NULL)
+        return cycles;
+
+    cov->executed[site.pc >> 3] |= 1 << (site.pc & 7);
+    cov->runs[site.pc]++;
+
+    MemAccess acc;
+    decodeAccess(&site, state->sp, &acc);
+    for (int i = 0; i < acc.reads; i++)
+        countRead(cov, homeAddress(state, acc.read[i]));
+    for (int i = 0; i < acc.writes; i++)
+        countWrite(cov, homeAddress(state, acc.write[i]));
+    return cycles;
+}
+
+static inline int wasExecuted(Coverage* cov, int addr) {
+    return cov->executed[addr >> 3] >> (addr & 7) & 1;
+}
+
+void writeCoverageListing(Coverage* cov, uint8_t* mem, FILE* out) {
+    int covered = 0, instructions = 0;
+    for (int pc = 0; pc < ROM_SIZE; pc++) {
+        if (wasExecuted(cov, pc)) {
+            covered += Disassemble8080To(NULL, mem, pc);
+            instructions++;
+        }
+    }
+    fprintf(out, "; %d instructions, %d of %d ROM bytes executed (%.1f%%)\n",
+        instructions, covered, ROM_SIZE, 100.0 * covered / ROM_SIZE);
+    fprintf(out, "; reads: %llu ROM, %llu work RAM, %llu VRAM\n", (unsigned long long) cov->romReads,
+        (unsigned long long) cov->ramReads, (unsigned long long) cov->vramReads);
+    fprintf(out, "; writes: %llu work RAM, %llu VRAM\n;\n", (unsigned long long) cov->ramWrites,
+        (unsigned long long) cov->vramWrites);
+    fprintf(out, "; runs       addr\top\tinstruction\n");
+
+    // bytes nothing started at are one line per run, with the data reads they saw
+    int pc = 0;
+    while (pc < ROM_SIZE) {
+        if (wasExecuted(cov, pc)) {
+            fprintf(out, "%12llu  ", (unsigned long long) cov->runs[pc]);
+            pc += Disassemble8080To(out, mem, pc);
+            fprintf(out, "\n");
+            continue;
+        }
+        int start = pc;
+        uint64_t reads = 0;
+        while (pc < ROM_SIZE && !wasExecuted(cov, pc))
+            reads += cov->reads[pc++];
+        fprintf(out, "%12s  %04x-%04x\tnot executed, %d bytes", "", start, pc - 1, pc - start);
+        if (reads)
+            fprintf(out, ", read %llu times", (unsigned long long) reads);
+        fprintf(out, "\n");
+    }
+}
+
+static void writeU64s(FILE* out, uint64_t* values, int n) {
+    uint8_t bytes[8];
+    for (int i = 0; i < n; i++) {
+        for (int b = 0; b < 8; b++)
+            bytes[b] = values[i] >> (b * 8);
+        fwrite(bytes, 1, 8, out);
+    }
+}
+
+int writeHeatmap(Coverage* cov, const char* path) {
+    FILE* out = fopen(path, "wb");
+    if (out == NULL)
+        return 0;
+    fwrite(COVERAGE_MAGIC, 1, sizeof(COVERAGE_MAGIC), out);
+    writeU64s(out, cov->runs, 0x10000);
+    writeU64s(out, cov->reads, 0x10000);
+    writeU64s(out, cov->writes, 0x10000);
+    fwrite(cov->executed, 1, sizeof(cov->executed), out);
+    fclose(out);
+    return 1;
+}
@@ -0,0 +1,43 @@
+#ifndef __coverage_h__
+#define __coverage_h__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "cpu.h"
+
+#define COVERAGE_MAGIC "SIHEAT1"
+
+/*
+    Which ROM bytes run and which memory is hot, to pick targets for
+    predecoding, fusion or the recompiler. Collected by stepCoverage, a
+    StepFn wrapping stepMachine that works out each instruction's memory
+    accesses with decodeAccess, so the normal cores carry no
+    instrumentation at all. Accesses through a mirror are counted at the
+    RAM address it repeats. Pushes done by interrupts aren't counted.
+*/
+typedef struct Coverage {
+    uint8_t executed[0x10000 / 8];      // bit per address an instruction started at
+    uint64_t runs[0x10000];             // times each address was executed
+    uint64_t reads[0x10000];            // data reads, not instruction fetches
+    uint64_t writes[0x10000];
+
+    uint64_t romReads;
+    uint64_t ramReads, ramWrites;       // work RAM, 0x2000-0x23ff
+    uint64_t vramReads, vramWrites;
+} Coverage;
+
+// stepCoverage records into cov until another is started, NULL stops recording
+void    startCoverage(Coverage* cov);
+int     stepCoverage(CPUState* state);
+
+// ROM listing with run counts beside each executed instruction
+void    writeCoverageListing(Coverage* cov, uint8_t* mem, FILE* out);
+
+/*
+    Binary heatmap, little endian: COVERAGE_MAGIC and a NUL, then runs,
+    reads and writes as 65536 u64 each, then the executed bitmap.
+    Returns 0 if the file can't be written.
+*/
+int     writeHeatmap(Coverage* cov, const char* path);
+
+#endif
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cpu.h"
+#include "cpm.h"
+#include "memmap.h"
+
+// instructions between checks of the wall clock
+#define CPM_SLICE (1 << 20)
+
+int initializeCPM(CPM* cpm, const char* path) {
+    memset(cpm, 0, sizeof(CPM));
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+        return 0;
+    cpm->cpu.mem = calloc(1, 0x10000);
+    cpm->cpu.map = &flatMap;    // flat, so the BDOS traps below can use mem directly
+    fread(&cpm->cpu.mem[CPM_TPA], 1, CPM_TOP - CPM_TPA, f);
+    fclose(f);
+
+    // JMP to the BDOS, whose address doubles as the top of usable memory
+    uint8_t* mem = cpm->cpu.mem;
+    mem[CPM_BDOS] = 0xc3;
+    mem[CPM_BDOS + 1] = CPM_TOP & 0xff;
+    mem[CPM_BDOS + 2] = CPM_TOP >> 8;
+    mem[CPM_TOP] = 0xc9;
+    cpm->cpu.pc = CPM_TPA;
+    cpm->cpu.sp = CPM_TOP;
+
+    cpm->capacity = 256;
+    cpm->output = malloc(cpm->capacity);
+    cpm->output[0] = 0;
+    return 1;
+}
+
+void freeCPM(CPM* cpm) {
+    free(cpm->cpu.mem);
+    free(cpm->output);
+}
+
+static void putOutput(CPM* cpm, char c) {
+    if (cpm->length + 1 >= cpm->capacity) {
+        cpm->capacity *= 2;
+        cpm->output = realloc(cpm->output, cpm->capacity);
+    }
+    cpm->output[cpm->length++] = c;
+    cpm->output[cpm->length] = 0;
+    if (cpm->echo)
+        putchar(c);
+}
+
+static void bdos(CPM* cpm) {
+    CPUState* state = &cpm->cpu;
+    if (state->c == 2) {
+        putOutput(cpm, state->e);
+    } else if (state->c == 9) {
+        uint16_t addr = state->d << 8 | state->e;
+        // bounded in case the string never ends
+        for (int i = 0; i < 0x10000 && state->mem[addr] != '$'; i++)
+            putOutput(cpm, state->mem[addr++]);
+    }
+}
+
+int stepCPM(CPUState* state) {
+    CPM* cpm = (CPM*) state;
+    cpm->instructions++;
+    if (state->pc == CPM_BDOS) {
+        bdos(cpm);
+        // returns as if the BDOS had run its RET
+        state->pc = state->mem[state->sp + 1] << 8 | state->mem[state->sp];
+        state->sp += 2;
+        return 10;
+    }
+    if (state->pc == 0) {
+        cpm->status = CPM_BOOTED;
+        return 0;
+    }
+
+    uint8_t* op = &state->mem[state->pc];
+    if (*op == 0x76) {
+        cpm->status = CPM_HALTED;
+        return 0;
+    } else if (*op == 0xdb || *op == 0xd3) {
+        // no devices, IN reads 0
+        if (*op == 0xdb)
+            state->a = 0;
+        state->pc += 2;
+        return 10;
+    }
+    return EmulateCPU(state);
+}
+
+static int64_t nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+int runCPM(CPM* cpm, uint64_t maxInstructions, int timeoutMs) {
+    int64_t deadline = nowMs() + timeoutMs;
+    while (cpm->status == CPM_RUNNING) {
+        uint64_t slice = CPM_SLICE;
+        if (maxInstructions && maxInstructions - cpm->instructions < slice)
+            slice = maxInstructions - cpm->instructions;
+        for (uint64_t i = 0; i < slice && cpm->status == CPM_RUNNING; i++)
+            stepCPM(&cpm->cpu);
+        if (cpm->status != CPM_RUNNING)
+            break;
+        if ((maxInstructions && cpm->instructions >= maxInstructions) ||
+            (timeoutMs && nowMs() >= deadline))
+            cpm->status = CPM_TIMEOUT;
+    }
+    return cpm->status;
+}
@@ -0,0 +1,44 @@
+#ifndef __cpm_h__
+#define __cpm_h__
+
+#include <stdint.h>
+#include "cpu.h"
+
+#define CPM_TPA 0x0100      // programs load and start here
+#define CPM_BDOS 0x0005     // CALL 5 is a BDOS request
+#define CPM_TOP 0xfe00      // what programs read at 0x0006 as the top of memory
+
+enum {
+    CPM_RUNNING,
+    CPM_BOOTED,         // jumped to 0, how CP/M programs exit
+    CPM_HALTED,         // ran HLT
+    CPM_TIMEOUT         // out of instructions or wall time
+};
+
+/*
+    Just enough CP/M to run 8080 test programs: BDOS functions 2 (print
+    the char in E) and 9 (print the $ terminated string at DE), and warm
+    boot at 0 ending the run. Calls are trapped by stepCPM before the
+    instruction at the trap address runs, so EmulateCPU carries no test
+    logic. The CPUState comes first so the step can find its CPM.
+*/
+typedef struct CPM {
+    CPUState cpu;
+    char* output;       // everything printed, NUL terminated
+    int length;
+    int capacity;
+    int echo;           // print to stdout as well
+    int status;
+    uint64_t instructions;
+} CPM;
+
+// 64K of memory with the program at CPM_TPA, 0 if the file can't be read
+int     initializeCPM(CPM* cpm, const char* path);
+void    freeCPM(CPM* cpm);
+
+int     stepCPM(CPUState* state);
+
+// runs until boot, HLT, maxInstructions or timeoutMs of wall time, 0 for no limit
+int     runCPM(CPM* cpm, uint64_t maxInstructions, int timeoutMs);
+
+#endif
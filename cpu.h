@@ -1,44 +1,98 @@
-#include <stdint.h>
-#ifndef __cpu_h__
-#define __cpu_h__
-
-
-typedef struct FlagRegister {
-    uint8_t c:1;        // carry flag 
-    uint8_t p:1;        // parity flag 
-    uint8_t ac:1;       // auxillary carry flag
-    uint8_t z:1;        // zero flag
-    uint8_t s:1;        // sign flag
-    uint8_t pad:3;
-} FlagRegister;
-
-// IO ports 
-typedef struct Ports {
-    uint8_t read1;      // inputs
-    uint8_t read2;      // inputs
-    uint8_t read3;      // bit shift register read
-
-    // only including relevant ports 
-    uint8_t write2;
-    uint8_t write4;
-} Ports;
-
-typedef struct CPUState {
-    uint8_t b;          // registers 0..6
-    uint8_t c;
-    uint8_t d;
-    uint8_t e;
-    uint8_t h;
-    uint8_t l;
-    uint8_t a;          // accumulator
-    uint16_t pc;        // special registers
-    uint16_t sp;
-    uint8_t *mem;       // arr of bytes
-    struct Ports ports;
-    struct FlagRegister flags;
-    uint8_t int_enable; // ??
-} CPUState;
-
-void    EmulateCPU(CPUState* state);
-
+#include <stdint.h>
+#ifndef __cpu_h__
+#define __cpu_h__
+
+
+typedef struct FlagRegister {
+    uint8_t c:1;        // carry flag 
+    uint8_t p:1;        // parity flag 
+    uint8_t ac:1;       // auxillary carry flag
+    uint8_t z:1;        // zero flag
+    uint8_t s:1;        // sign flag
+    uint8_t pad:3;
+} FlagRegister;
+
+// kind of the last flag-setting ALU op
+enum { LAZY_NONE, LAZY_ARITH, LAZY_LOGIC };
+
+#ifdef LAZY_FLAGS
+// S, Z, P, C and AC are derived from these on demand instead of after every op
+typedef struct LazyFlags {
+    uint16_t res;       // untruncated result, bit 8 is the carry/borrow
+    uint8_t aux;        // bit 4 is the carry out of bit 3
+    uint8_t op;         // LAZY_NONE when flags is up to date
+} LazyFlags;
+#endif
+
+// why the CPU stopped, it then stays on the instruction that stopped it
+enum { CPU_RUNNING, CPU_HALTED, CPU_FAULTED };
+
+// IO ports 
+typedef struct Ports {
+    uint8_t read1;      // inputs
+    uint8_t read2;      // inputs
+    uint16_t read3;     // bit shift register read
+
+    // only including relevant ports 
+    uint8_t write2;
+    uint8_t write4;
+    uint8_t write3;     // sound latches
+    uint8_t write5;
+    uint8_t rising3;    // sound bits turned on since the mixer last looked
+    uint8_t rising5;
+} Ports;
+
+typedef struct CPUState {
+    uint8_t b;          // registers 0..6
+    uint8_t c;
+    uint8_t d;
+    uint8_t e;
+    uint8_t h;
+    uint8_t l;
+    uint8_t a;          // accumulator
+    uint16_t pc;        // special registers
+    uint16_t sp;
+    uint8_t *mem;       // arr of bytes
+    const struct MemoryMap* map;   // how addresses reach mem, see memmap.h
+    struct Ports ports;
+    struct FlagRegister flags;
+#ifdef LAZY_FLAGS
+    struct LazyFlags lazy;
+#endif
+    uint8_t int_enable; // ??
+    uint8_t stopped;    // CPU_* once HLT or an unimplemented opcode ran
+} CPUState;
+
+extern const uint8_t cycles8080[256];
+
+// called when an unimplemented instruction stops the CPU, e.g. to dump a trace
+extern void (*faultHook)(CPUState* state);
+
+// executes one instruction, returns the clock cycles it took
+int     EmulateCPU(CPUState* state);
+void    generateInterrupt(CPUState* state, uint16_t addr);
+
+// helpers shared with the recompiled backend
+void    push(CPUState* state, uint16_t regval);
+void    add(CPUState* state, uint8_t regval);
+void    adc(CPUState* state, uint8_t regval);
+void    sub(CPUState* state, uint8_t regval);
+void    sbb(CPUState* state, uint8_t regval);
+void    ana(CPUState* state, uint8_t regval);
+void    ora(CPUState* state, uint8_t regval);
+void    xra(CPUState* state, uint8_t regval);
+void    cmp(CPUState* state, uint8_t regval);
+void    dad(CPUState* state, uint16_t val);
+void    inr(CPUState* state, uint8_t* reg);
+void    dcr(uint8_t* reg, CPUState* state);
+void    dcx(uint8_t* reg1, uint8_t* reg2);
+void    updateAllFlags(uint16_t val, CPUState* state);
+
+#ifdef LAZY_FLAGS
+void    materializeFlags(CPUState* state);
+#define syncFlags(state) do { if ((state)->lazy.op != LAZY_NONE) materializeFlags(state); } while (0)
+#else
+#define syncFlags(state) do { } while (0)
+#endif
+
 #endif
\ No newline at end of file
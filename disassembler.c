@@ -1,268 +1,280 @@
-#include <stdio.h>
-#include <stdlib.h>
-
-/*
-    @params
-    stream is valid ptr to 8080 asm code
-    pc is offset into code
-
-    @return
-    # of bytes in op
-*/
-int Disassemble8080(unsigned char* stream, int pc) {
-    unsigned char *code = &stream[pc];
-    unsigned char val = *code;
-    int opSize = 1;
-    printf("%04x\t", pc);
-    printf("%02x\t", val);
-    switch (val) {
-        case 0x00: printf("NOP             "); break;
-        case 0x01: printf("LXI  B, %02x%02x    ", code[2], code[1]); opSize=3; break; // copy values[1],[2] to regs C,B
-        case 0x02: printf("STAX B          "); break; // A into (BC)
-        case 0x03: printf("INX  B          "); break; // inc BC by 1
-        case 0x04: printf("INR  B          "); break; // inc B by 1
-        case 0x05: printf("DCR  B          "); break; // dec B by 1
-        case 0x06: printf("MVI  B, %02x      ", code[1]); opSize=2; break; // B <- value[1]
-        case 0x07: printf("RLC             "); break; // A << 1, bit 0 becomes carry bit, gets previous read's bit 7 
-        case 0x09: printf("DAD  B          "); break; // adds BC to HL (mem?)
-        case 0x0a: printf("LDAX B          "); break; // move BC to A
-        case 0x0b: printf("DCX  B          "); break; // dec BC
-        case 0x0c: printf("INR  C          "); break; 
-        case 0x0d: printf("DCR  C          "); break;
-        case 0x0e: printf("MVI  C, %02x      ", code[1]); opSize=2; break;
-        case 0x0f: printf("RRC             "); break; // A >> 1, bit 7 gets previous read's bit 0
-        case 0x11: printf("LXI  D, %02x%02x    ", code[2], code[1]); opSize=3; break; // mov data[1],data[2] to ED
-        case 0x12: printf("STAX D          "); break;
-        case 0x13: printf("INX  D          "); break;
-        case 0x14: printf("INR  D          "); break;
-        case 0x15: printf("DCR  D          "); break;
-        case 0x16: printf("MVI  D, %02x      ", code[1]); opSize=2; break;
-        case 0x17: printf("RAL             "); break;
-        case 0x19: printf("DAD  D          "); break;
-        case 0x1a: printf("LDAX D          "); break;
-        case 0x1b: printf("DCX  D          "); break; // started seeing a pattern in IS here
-        case 0x1c: printf("INR  E          "); break; 
-        case 0x1d: printf("DCR  E          "); break;
-        case 0x1e: printf("MVI  E, %02x      ", code[1]); opSize=2; break;
-        case 0x1f: printf("RAR             "); break;
-        case 0x21: printf("LXI  H, %02x%02x    ", code[2], code[1]); opSize=3; break;
-        case 0x22: printf("SHLD %02x%02x     ", code[2], code[1]); opSize=3; break;
-        case 0x23: printf("INX  H          "); break;
-        case 0x24: printf("INR  H          "); break;
-        case 0x25: printf("DCR  H          "); break;
-        case 0x26: printf("MVI  H, %02x      ", code[1]); opSize=2; break;
-        case 0x27: printf("DAA             "); break; // special
-        case 0x29: printf("DAD  H          "); break;
-        case 0x2a: printf("LHLD %02x%02x       ", code[2], code[1]); opSize=3; break;
-        case 0x2b: printf("DCX  H          "); break;
-        case 0x2c: printf("INR  L          "); break; 
-        case 0x2d: printf("DCR  L          "); break;
-        case 0x2e: printf("MVI  L, %02x      ", code[1]); opSize=2; break;
-        case 0x2f: printf("CMA             "); break;
-        case 0x31: printf("LXI SP, %02x%02x   ", code[2], code[1]); opSize=3; break; // SP = stack pointer, special reg
-        case 0x32: printf("STA %02x%02x      ", code[2], code[1]); opSize=3; break;
-        case 0x33: printf("INX  SP         "); break;
-        case 0x34: printf("INR  M          "); break;
-        case 0x35: printf("DCR  M          "); break;
-        case 0x36: printf("MVI  M, %02x      ", code[1]); opSize=2; break;
-        case 0x37: printf("STC             "); break;
-        case 0x39: printf("DAD  SP         "); break;
-        case 0x3a: printf("LDA %02x%02x        ", code[2], code[1]); opSize=3; break;
-        case 0x3b: printf("DCX  SP         "); break;
-        case 0x3c: printf("INR  A          "); break; 
-        case 0x3d: printf("DCR  A          "); break;
-        case 0x3e: printf("MVI  A, %02x    ", code[1]); opSize=2; break;
-        case 0x3f: printf("CMC             "); break;
-        case 0x40: printf("MOV B,B         "); break;
-        case 0x41: printf("MOV B,C         "); break;
-        case 0x42: printf("MOV B,D         "); break;
-        case 0x43: printf("MOV B,E         "); break;
-        case 0x44: printf("MOV B,H         "); break;
-        case 0x45: printf("MOV B,L         "); break;
-        case 0x46: printf("MOV B,M         "); break;
-        case 0x47: printf("MOV B,A         "); break;
-        case 0x48: printf("MOV C,B         "); break;
-        case 0x49: printf("MOV C,C         "); break;
-        case 0x4a: printf("MOV C,D         "); break;
-        case 0x4b: printf("MOV C,E         "); break;
-        case 0x4c: printf("MOV C,H         "); break;
-        case 0x4d: printf("MOV C,L         "); break;
-        case 0x4e: printf("MOV C,M         "); break;
-        case 0x4f: printf("MOV C,A         "); break;
-        case 0x50: printf("MOV D,B         "); break;
-        case 0x51: printf("MOV D,C         "); break;
-        case 0x52: printf("MOV D,D         "); break;
-        case 0x53: printf("MOV D,E         "); break;
-        case 0x54: printf("MOV D,H         "); break;
-        case 0x55: printf("MOV D,L         "); break;
-        case 0x56: printf("MOV D,M         "); break;
-        case 0x57: printf("MOV D,A         "); break;
-        case 0x58: printf("MOV E,B         "); break;
-        case 0x59: printf("MOV E,C         "); break;
-        case 0x5a: printf("MOV E,D         "); break;
-        case 0x5b: printf("MOV E,E         "); break;
-        case 0x5c: printf("MOV E,H         "); break;
-        case 0x5d: printf("MOV E,L         "); break;
-        case 0x5e: printf("MOV E,M         "); break;
-        case 0x5f: printf("MOV E,A         "); break;
-        case 0x60: printf("MOV H,B         "); break;
-        case 0x61: printf("MOV H,C         "); break;
-        case 0x62: printf("MOV H,D         "); break;
-        case 0x63: printf("MOV H,E         "); break;
-        case 0x64: printf("MOV H,H         "); break;
-        case 0x65: printf("MOV H,L         "); break;
-        case 0x66: printf("MOV H,M         "); break;
-        case 0x67: printf("MOV H,A         "); break;
-        case 0x68: printf("MOV L,B         "); break;
-        case 0x69: printf("MOV L,C         "); break;
-        case 0x6a: printf("MOV L,D         "); break;
-        case 0x6b: printf("MOV L,E         "); break;
-        case 0x6c: printf("MOV L,H         "); break;
-        case 0x6d: printf("MOV L,L         "); break;
-        case 0x6e: printf("MOV L,M         "); break;
-        case 0x6f: printf("MOV L,A         "); break;
-        case 0x70: printf("MOV M,B         "); break;
-        case 0x71: printf("MOV M,C         "); break;
-        case 0x72: printf("MOV M,D         "); break;
-        case 0x73: printf("MOV M,E         "); break;
-        case 0x74: printf("MOV M,H         "); break;
-        case 0x75: printf("MOV M,L         "); break;
-        case 0x76: printf("HLT             "); break;
-        case 0x77: printf("MOV M,A         "); break;
-        case 0x78: printf("MOV A,B         "); break;
-        case 0x79: printf("MOV A,C         "); break;
-        case 0x7a: printf("MOV A,D         "); break;
-        case 0x7b: printf("MOV A,E         "); break;
-        case 0x7c: printf("MOV A,H         "); break;
-        case 0x7d: printf("MOV A,L         "); break;
-        case 0x7e: printf("MOV A,M         "); break;
-        case 0x7f: printf("MOV A,A         "); break;
-        case 0x80: printf("ADD B           "); break;
-        case 0x81: printf("ADD C           "); break;
-        case 0x82: printf("ADD D           "); break;
-        case 0x83: printf("ADD E           "); break;
-        case 0x84: printf("ADD H           "); break;
-        case 0x85: printf("ADD L           "); break;
-        case 0x86: printf("ADD M           "); break;
-        case 0x87: printf("ADD A           "); break;
-        case 0x88: printf("ADC B           "); break;
-        case 0x89: printf("ADC C           "); break;
-        case 0x8a: printf("ADC D           "); break;
-        case 0x8b: printf("ADC E           "); break;
-        case 0x8c: printf("ADC H           "); break;
-        case 0x8d: printf("ADC L           "); break;
-        case 0x8e: printf("ADC M           "); break;
-        case 0x8f: printf("ADC A           "); break;
-        case 0x90: printf("SUB B           "); break;
-        case 0x91: printf("SUB C           "); break;
-        case 0x92: printf("SUB D           "); break;
-        case 0x93: printf("SUB E           "); break;
-        case 0x94: printf("SUB H           "); break;
-        case 0x95: printf("SUB L           "); break;
-        case 0x96: printf("SUB M           "); break;
-        case 0x97: printf("SUB A           "); break;
-        case 0x98: printf("SBB B           "); break;
-        case 0x99: printf("SBB C           "); break;
-        case 0x9a: printf("SBB D           "); break;
-        case 0x9b: printf("SBB E           "); break;
-        case 0x9c: printf("SBB H           "); break;
-        case 0x9d: printf("SBB L           "); break;
-        case 0x9e: printf("SBB M           "); break;
-        case 0x9f: printf("SBB A           "); break;
-        case 0xa0: printf("ANA B           "); break;
-        case 0xa1: printf("ANA C           "); break;
-        case 0xa2: printf("ANA D           "); break;
-        case 0xa3: printf("ANA E           "); break;
-        case 0xa4: printf("ANA H           "); break;
-        case 0xa5: printf("ANA L           "); break;
-        case 0xa6: printf("ANA M           "); break;
-        case 0xa7: printf("ANA A           "); break;
-        case 0xa8: printf("XRA B           "); break;
-        case 0xa9: printf("XRA C           "); break;
-        case 0xaa: printf("XRA D           "); break;
-        case 0xab: printf("XRA E           "); break;
-        case 0xac: printf("XRA H           "); break;
-        case 0xad: printf("XRA L           "); break;
-        case 0xae: printf("XRA M           "); break;
-        case 0xaf: printf("XRA A           "); break;
-        case 0xb0: printf("ORA B           "); break;
-        case 0xb1: printf("ORA C           "); break;
-        case 0xb2: printf("ORA D           "); break;
-        case 0xb3: printf("ORA E           "); break;
-        case 0xb4: printf("ORA H           "); break;
-        case 0xb5: printf("ORA L           "); break;
-        case 0xb6: printf("ORA M           "); break;
-        case 0xb7: printf("ORA A           "); break;
-        case 0xb8: printf("CMP B           "); break;
-        case 0xb9: printf("CMP C           "); break;
-        case 0xba: printf("CMP D           "); break;
-        case 0xbb: printf("CMP E           "); break;
-        case 0xbc: printf("CMP H           "); break;
-        case 0xbd: printf("CMP L           "); break;
-        case 0xbe: printf("CMP M           "); break;
-        case 0xbf: printf("CMP A           "); break;
-        case 0xc0: printf("RNZ             "); break;
-        case 0xc1: printf("POP B           "); break;
-        case 0xc2: printf("JNZ %02x%02x        ", code[2], code[1]); opSize=3; break;
-        case 0xc3: printf("JMP %02x%02x        ", code[2], code[1]); opSize=3; break;
-        case 0xc4: printf("CNZ %02x%02x        ", code[2], code[1]); opSize=3; break;
-        case 0xc5: printf("PUSH BC         "); break;
-        case 0xc6: printf("ADI %02x          ", code[1]); opSize=2; break;
-        case 0xc7: printf("RST 0           "); break;
-        case 0xc8: printf("RZ              "); break;
-        case 0xc9: printf("RET             "); break;
-        case 0xca: printf("JZ %02x%02x         ", code[2], code[1]); opSize=3; break;
-        case 0xcc: printf("CZ %02x%02x         ", code[2], code[1]); opSize=3; break;
-        case 0xcd: printf("CALL %02x%02x       ", code[2], code[1]); opSize=3; break;
-        case 0xce: printf("ACI %02x          ", code[1]); opSize=2; break;
-        case 0xcf: printf("RST 1           "); break;
-        case 0xd0: printf("RNC             "); break;
-        case 0xd1: printf("POP D           "); break;
-        case 0xd2: printf("JNC %02x%02x        ", code[2], code[1]); opSize=3; break;
-        case 0xd3: printf("OUT %02x          ", code[1]); opSize=2; break;
-        case 0xd4: printf("CNC %02x%02x        ", code[2], code[1]); opSize=3; break;
-        case 0xd5: printf("PUSH D          "); break;
-        case 0xd6: printf("SUI %02x          ", code[1]); opSize=2;break;
-        case 0xd7: printf("RST 2           "); break;
-        case 0xd8: printf("RC              "); break;
-        case 0xda: printf("JC %02x%02x         ", code[2],code[1]); opSize=3; break;
-        case 0xdb: printf("IN %02x         ", code[1]); opSize=2;break;
-        case 0xdc: printf("CC %02x%02x         ", code[2],code[1]); opSize=3; break;
-        case 0xde: printf("SBI %02x          ", code[1]); opSize=2;break;
-        case 0xdf: printf("RST 3           "); break;
-        case 0xe0: printf("RPO             "); break;
-        case 0xe1: printf("POP H           "); break;
-        case 0xe2: printf("JPO %02x%02x        ", code[2], code[1]); opSize=3; break;
-        case 0xe3: printf("XTHL            "); break;
-        case 0xe4: printf("CPO %02x%02x        ", code[2], code[1]); opSize=3; break;
-        case 0xe5: printf("PUSH H          "); break;
-        case 0xe6: printf("ANI %02x          ", code[1]); opSize=2;break;
-        case 0xe7: printf("RST 4           "); break;
-        case 0xe8: printf("RPE             "); break;
-        case 0xe9: printf("PCHL            "); break;
-        case 0xea: printf("JPE %02x%02x        ", code[2], code[1]); opSize=3; break;
-        case 0xeb: printf("XCHG            "); break;
-        case 0xec: printf("CPE %02x%02x        ", code[2], code[1]); opSize=3; break;
-        case 0xee: printf("XRI %02x          ", code[1]); opSize=2;break;
-        case 0xef: printf("RST 5           "); break;
-        case 0xf0: printf("RP              "); break;
-        case 0xf1: printf("POP PSW         "); break;
-        case 0xf2: printf("JP %02x%02x         ", code[2], code[1]); opSize=3; break;
-        case 0xf3: printf("RP              "); break;
-        case 0xf4: printf("CP %02x%02x         ", code[2], code[1]); opSize=3; break;
-        case 0xf5: printf("PUSH PSW        "); break;
-        case 0xf6: printf("ORI %02x          ", code[1]); opSize=2;break;
-        case 0xf7: printf("RST 6           "); break;
-        case 0xf8: printf("RM              "); break;
-        case 0xf9: printf("SPHL            "); break;
-        case 0xfa: printf("JM %02x%02x         ", code[2], code[1]); opSize=3; break;
-        case 0xfb: printf("EI              "); break;
-        case 0xfc: printf("CM %02x%02x         ", code[2], code[1]); opSize=3; break;
-        case 0xfe: printf("CPI %02x          ", code[1]); opSize=2;break;
-        case 0xff: printf("RST 7           "); break;
-        default: printf("ERR"); break;
-    }
-    // could absolutely refactor this
-    // printf("\n");
-    return opSize;
+#include <stdio.h>
+#include <stdlib.h>
+
+// out can be NULL to only decode the op size
+#define emit(...) if (out) fprintf(out, __VA_ARGS__)
+
+/*
+    @params
+    out is where the listing goes, NULL for none
+    code points at the op's bytes, which need not be in memory at pc
+    pc is the address printed for it
+
+    @return
+    # of bytes in op
+*/
+int Disassemble8080Op(FILE* out, unsigned char* code, int pc) {
+    unsigned char val = *code;
+    int opSize = 1;
+    emit("%04x\t", pc);
+    emit("%02x\t", val);
+    switch (val) {
+        case 0x00: emit("NOP             "); break;
+        case 0x01: emit("LXI  B, %02x%02x    ", code[2], code[1]); opSize=3; break; // copy values[1],[2] to regs C,B
+        case 0x02: emit("STAX B          "); break; // A into (BC)
+        case 0x03: emit("INX  B          "); break; // inc BC by 1
+        case 0x04: emit("INR  B          "); break; // inc B by 1
+        case 0x05: emit("DCR  B          "); break; // dec B by 1
+        case 0x06: emit("MVI  B, %02x      ", code[1]); opSize=2; break; // B <- value[1]
+        case 0x07: emit("RLC             "); break; // A << 1, bit 0 becomes carry bit, gets previous read's bit 7 
+        case 0x09: emit("DAD  B          "); break; // adds BC to HL (mem?)
+        case 0x0a: emit("LDAX B          "); break; // move BC to A
+        case 0x0b: emit("DCX  B          "); break; // dec BC
+        case 0x0c: emit("INR  C          "); break; 
+        case 0x0d: emit("DCR  C          "); break;
+        case 0x0e: emit("MVI  C, %02x      ", code[1]); opSize=2; break;
+        case 0x0f: emit("RRC             "); break; // A >> 1, bit 7 gets previous read's bit 0
+        case 0x11: emit("LXI  D, %02x%02x    ", code[2], code[1]); opSize=3; break; // mov data[1],data[2] to ED
+        case 0x12: emit("STAX D          "); break;
+        case 0x13: emit("INX  D          "); break;
+        case 0x14: emit("INR  D          "); break;
+        case 0x15: emit("DCR  D          "); break;
+        case 0x16: emit("MVI  D, %02x      ", code[1]); opSize=2; break;
+        case 0x17: emit("RAL             "); break;
+        case 0x19: emit("DAD  D          "); break;
+        case 0x1a: emit("LDAX D          "); break;
+        case 0x1b: emit("DCX  D          "); break; // started seeing a pattern in IS here
+        case 0x1c: emit("INR  E          "); break; 
+        case 0x1d: emit("DCR  E          "); break;
+        case 0x1e: emit("MVI  E, %02x      ", code[1]); opSize=2; break;
+        case 0x1f: emit("RAR             "); break;
+        case 0x21: emit("LXI  H, %02x%02x    ", code[2], code[1]); opSize=3; break;
+        case 0x22: emit("SHLD %02x%02x     ", code[2], code[1]); opSize=3; break;
+        case 0x23: emit("INX  H          "); break;
+        case 0x24: emit("INR  H          "); break;
+        case 0x25: emit("DCR  H          "); break;
+        case 0x26: emit("MVI  H, %02x      ", code[1]); opSize=2; break;
+        case 0x27: emit("DAA             "); break; // special
+        case 0x29: emit("DAD  H          "); break;
+        case 0x2a: emit("LHLD %02x%02x       ", code[2], code[1]); opSize=3; break;
+        case 0x2b: emit("DCX  H          "); break;
+        case 0x2c: emit("INR  L          "); break; 
+        case 0x2d: emit("DCR  L          "); break;
+        case 0x2e: emit("MVI  L, %02x      ", code[1]); opSize=2; break;
+        case 0x2f: emit("CMA             "); break;
+        case 0x31: emit("LXI SP, %02x%02x   ", code[2], code[1]); opSize=3; break; // SP = stack pointer, special reg
+        case 0x32: emit("STA %02x%02x      ", code[2], code[1]); opSize=3; break;
+        case 0x33: emit("INX  SP         "); break;
+        case 0x34: emit("INR  M          "); break;
+        case 0x35: emit("DCR  M          "); break;
+        case 0x36: emit("MVI  M, %02x      ", code[1]); opSize=2; break;
+        case 0x37: emit("STC             "); break;
+        case 0x39: emit("DAD  SP         "); break;
+        case 0x3a: emit("LDA %02x%02x        ", code[2], code[1]); opSize=3; break;
+        case 0x3b: emit("DCX  SP         "); break;
+        case 0x3c: emit("INR  A          "); break; 
+        case 0x3d: emit("DCR  A          "); break;
+        case 0x3e: emit("MVI  A, %02x    ", code[1]); opSize=2; break;
+        case 0x3f: emit("CMC             "); break;
+        case 0x40: emit("MOV B,B         "); break;
+        case 0x41: emit("MOV B,C         "); break;
+        case 0x42: emit("MOV B,D         "); break;
+        case 0x43: emit("MOV B,E         "); break;
+        case 0x44: emit("MOV B,H         "); break;
+        case 0x45: emit("MOV B,L         "); break;
+        case 0x46: emit("MOV B,M         "); break;
+        case 0x47: emit("MOV B,A         "); break;
+        case 0x48: emit("MOV C,B         "); break;
+        case 0x49: emit("MOV C,C         "); break;
+        case 0x4a: emit("MOV C,D         "); break;
+        case 0x4b: emit("MOV C,E         "); break;
+        case 0x4c: emit("MOV C,H         "); break;
+        case 0x4d: emit("MOV C,L         "); break;
+        case 0x4e: emit("MOV C,M         "); break;
+        case 0x4f: emit("MOV C,A         "); break;
+        case 0x50: emit("MOV D,B         "); break;
+        case 0x51: emit("MOV D,C         "); break;
+        case 0x52: emit("MOV D,D         "); break;
+        case 0x53: emit("MOV D,E         "); break;
+        case 0x54: emit("MOV D,H         "); break;
+        case 0x55: emit("MOV D,L         "); break;
+        case 0x56: emit("MOV D,M         "); break;
+        case 0x57: emit("MOV D,A         "); break;
+        case 0x58: emit("MOV E,B         "); break;
+        case 0x59: emit("MOV E,C         "); break;
+        case 0x5a: emit("MOV E,D         "); break;
+        case 0x5b: emit("MOV E,E         "); break;
+        case 0x5c: emit("MOV E,H         "); break;
+        case 0x5d: emit("MOV E,L         "); break;
+        case 0x5e: emit("MOV E,M         "); break;
+        case 0x5f: emit("MOV E,A         "); break;
+        case 0x60: emit("MOV H,B         "); break;
+        case 0x61: emit("MOV H,C         "); break;
+        case 0x62: emit("MOV H,D         "); break;
+        case 0x63: emit("MOV H,E         "); break;
+        case 0x64: emit("MOV H,H         "); break;
+        case 0x65: emit("MOV H,L         "); break;
+        case 0x66: emit("MOV H,M         "); break;
+        case 0x67: emit("MOV H,A         "); break;
+        case 0x68: emit("MOV L,B         "); break;
+        case 0x69: emit("MOV L,C         "); break;
+        case 0x6a: emit("MOV L,D         "); break;
+        case 0x6b: emit("MOV L,E         "); break;
+        case 0x6c: emit("MOV L,H         "); break;
+        case 0x6d: emit("MOV L,L         "); break;
+        case 0x6e: emit("MOV L,M         "); break;
+        case 0x6f: emit("MOV L,A         "); break;
+        case 0x70: emit("MOV M,B         "); break;
+        case 0x71: emit("MOV M,C         "); break;
+        case 0x72: emit("MOV M,D         "); break;
+        case 0x73: emit("MOV M,E         "); break;
+        case 0x74: emit("MOV M,H         "); break;
+        case 0x75: emit("MOV M,L         "); break;
+        case 0x76: emit("HLT             "); break;
+        case 0x77: emit("MOV M,A         "); break;
+        case 0x78: emit("MOV A,B         "); break;
+        case 0x79: emit("MOV A,C         "); break;
+        case 0x7a: emit("MOV A,D         "); break;
+        case 0x7b: emit("MOV A,E         "); break;
+        case 0x7c: emit("MOV A,H         "); break;
+        case 0x7d: emit("MOV A,L         "); break;
+        case 0x7e: emit("MOV A,M         "); break;
+        case 0x7f: emit("MOV A,A         "); break;
+        case 0x80: emit("ADD B           "); break;
+        case 0x81: emit("ADD C           "); break;
+        case 0x82: emit("ADD D           "); break;
+        case 0x83: emit("ADD E           "); break;
+        case 0x84: emit("ADD H           "); break;
+        case 0x85: emit("ADD L           "); break;
+        case 0x86: emit("ADD M           "); break;
+        case 0x87: emit("ADD A           "); break;
+        case 0x88: emit("ADC B           "); break;
+        case 0x89: emit("ADC C           "); break;
+        case 0x8a: emit("ADC D           "); break;
+        case 0x8b: emit("ADC E           "); break;
+        case 0x8c: emit("ADC H           "); break;
+        case 0x8d: emit("ADC L           "); break;
+        case 0x8e: emit("ADC M           "); break;
+        case 0x8f: emit("ADC A           "); break;
+        case 0x90: emit("SUB B           "); break;
+        case 0x91: emit("SUB C           "); break;
+        case 0x92: emit("SUB D           "); break;
+        case 0x93: emit("SUB E           "); break;
+        case 0x94: emit("SUB H           "); break;
+        case 0x95: emit("SUB L           "); break;
+        case 0x96: emit("SUB M           "); break;
+        case 0x97: emit("SUB A           "); break;
+        case 0x98: emit("SBB B           "); break;
+        case 0x99: emit("SBB C           "); break;
+        case 0x9a: emit("SBB D           "); break;
+        case 0x9b: emit("SBB E           "); break;
+        case 0x9c: emit("SBB H           "); break;
+        case 0x9d: emit("SBB L           "); break;
+        case 0x9e: emit("SBB M           "); break;
+        case 0x9f: emit("SBB A           "); break;
+        case 0xa0: emit("ANA B           "); break;
+        case 0xa1: emit("ANA C           "); break;
+        case 0xa2: emit("ANA D           "); break;
+        case 0xa3: emit("ANA E           "); break;
+        case 0xa4: emit("ANA H           "); break;
+        case 0xa5: emit("ANA L           "); break;
+        case 0xa6: emit("ANA M           "); break;
+        case 0xa7: emit("ANA A           "); break;
+        case 0xa8: emit("XRA B           "); break;
+        case 0xa9: emit("XRA C           "); break;
+        case 0xaa: emit("XRA D           "); break;
+        case 0xab: emit("XRA E           "); break;
+        case 0xac: emit("XRA H           "); break;
+        case 0xad: emit("XRA L           "); break;
+        case 0xae: emit("XRA M           "); break;
+        case 0xaf: emit("XRA A           "); break;
+        case 0xb0: emit("ORA B           "); break;
+        case 0xb1: emit("ORA C           "); break;
+        case 0xb2: emit("ORA D           "); break;
+        case 0xb3: emit("ORA E           "); break;
+        case 0xb4: emit("ORA H           "); break;
+        case 0xb5: emit("ORA L           "); break;
+        case 0xb6: emit("ORA M           "); break;
+        case 0xb7: emit("ORA A           "); break;
+        case 0xb8: emit("CMP B           "); break;
+        case 0xb9: emit("CMP C           "); break;
+        case 0xba: emit("CMP D           "); break;
+        case 0xbb: emit("CMP E           "); break;
+        case 0xbc: emit("CMP H           "); break;
+        case 0xbd: emit("CMP L           "); break;
+        case 0xbe: emit("CMP M           "); break;
+        case 0xbf: emit("CMP A           "); break;
+        case 0xc0: emit("RNZ             "); break;
+        case 0xc1: emit("POP B           "); break;
+        case 0xc2: emit("JNZ %02x%02x        ", code[2], code[1]); opSize=3; break;
+        case 0xc3: emit("JMP %02x%02x        ", code[2], code[1]); opSize=3; break;
+        case 0xc4: emit("CNZ %02x%02x        ", code[2], code[1]); opSize=3; break;
+        case 0xc5: emit("PUSH BC         "); break;
+        case 0xc6: emit("ADI %02x          ", code[1]); opSize=2; break;
+        case 0xc7: emit("RST 0           "); break;
+        case 0xc8: emit("RZ              "); break;
+        case 0xc9: emit("RET             "); break;
+        case 0xca: emit("JZ %02x%02x         ", code[2], code[1]); opSize=3; break;
+        case 0xcc: emit("CZ %02x%02x         ", code[2], code[1]); opSize=3; break;
+        case 0xcd: emit("CALL %02x%02x       ", code[2], code[1]); opSize=3; break;
+        case 0xce: emit("ACI %02x          ", code[1]); opSize=2; break;
+        case 0xcf: emit("RST 1           "); break;
+        case 0xd0: emit("RNC             "); break;
+        case 0xd1: emit("POP D           "); break;
+        case 0xd2: emit("JNC %02x%02x        ", code[2], code[1]); opSize=3; break;
+        case 0xd3: emit("OUT %02x          ", code[1]); opSize=2; break;
+        case 0xd4: emit("CNC %02x%02x        ", code[2], code[1]); opSize=3; break;
+        case 0xd5: emit("PUSH D          "); break;
+        case 0xd6: emit("SUI %02x          ", code[1]); opSize=2;break;
+        case 0xd7: emit("RST 2           "); break;
+        case 0xd8: emit("RC              "); break;
+        case 0xda: emit("JC %02x%02x         ", code[2],code[1]); opSize=3; break;
+        case 0xdb: emit("IN %02x         ", code[1]); opSize=2;break;
+        case 0xdc: emit("CC %02x%02x         ", code[2],code[1]); opSize=3; break;
+        case 0xde: emit("SBI %02x          ", code[1]); opSize=2;break;
+        case 0xdf: emit("RST 3           "); break;
+        case 0xe0: emit("RPO             "); break;
+        case 0xe1: emit("POP H           "); break;
+        case 0xe2: emit("JPO %02x%02x        ", code[2], code[1]); opSize=3; break;
+        case 0xe3: emit("XTHL            "); break;
+        case 0xe4: emit("CPO %02x%02x        ", code[2], code[1]); opSize=3; break;
+        case 0xe5: emit("PUSH H          "); break;
+        case 0xe6: emit("ANI %02x          ", code[1]); opSize=2;break;
+        case 0xe7: emit("RST 4           "); break;
+        case 0xe8: emit("RPE             "); break;
+        case 0xe9: emit("PCHL            "); break;
+        case 0xea: emit("JPE %02x%02x        ", code[2], code[1]); opSize=3; break;
+        case 0xeb: emit("XCHG            "); break;
+        case 0xec: emit("CPE %02x%02x        ", code[2], code[1]); opSize=3; break;
+        case 0xee: emit("XRI %02x          ", code[1]); opSize=2;break;
+        case 0xef: emit("RST 5           "); break;
+        case 0xf0: emit("RP              "); break;
+        case 0xf1: emit("POP PSW         "); break;
+        case 0xf2: emit("JP %02x%02x         ", code[2], code[1]); opSize=3; break;
+        case 0xf3: emit("RP              "); break;
+        case 0xf4: emit("CP %02x%02x         ", code[2], code[1]); opSize=3; break;
+        case 0xf5: emit("PUSH PSW        "); break;
+        case 0xf6: emit("ORI %02x          ", code[1]); opSize=2;break;
+        case 0xf7: emit("RST 6           "); break;
+        case 0xf8: emit("RM              "); break;
+        case 0xf9: emit("SPHL            "); break;
+        case 0xfa: emit("JM %02x%02x         ", code[2], code[1]); opSize=3; break;
+        case 0xfb: emit("EI              "); break;
+        case 0xfc: emit("CM %02x%02x         ", code[2], code[1]); opSize=3; break;
+        case 0xfe: emit("CPI %02x          ", code[1]); opSize=2;break;
+        case 0xff: emit("RST 7           "); break;
+        default: emit("ERR"); break;
+    }
+    // could absolutely refactor this
+    // emit("\n");
+    return opSize;
+}
+
+// stream is valid ptr to 8080 asm code, pc is offset into code
+int Disassemble8080To(FILE* out, unsigned char* stream, int pc) {
+    return Disassemble8080Op(out, &stream[pc], pc);
+}
+
+int Disassemble8080(unsigned char* stream, int pc) {
+    return Disassemble8080To(stdout, stream, pc);
 }
\ No newline at end of file
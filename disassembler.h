@@ -1,6 +1,10 @@
-#ifndef __disassembler_h__
-#define __disassembler_h__
-
-int     Disassemble8080(unsigned char* stream, int pc);
-
+#ifndef __disassembler_h__
+#define __disassembler_h__
+
+#include <stdio.h>
+
+int     Disassemble8080(unsigned char* stream, int pc);
+int     Disassemble8080To(FILE* out, unsigned char* stream, int pc);
+int     Disassemble8080Op(FILE* out, unsigned char* code, int pc);
+
 #endif
\ No newline at end of file
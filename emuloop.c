@@ -0,0 +1,138 @@
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "cpu.h"
+#include "machine.h"
+#include "triplebuffer.h"
+#include "sound.h"
+#include "video.h"
+#include "metrics.h"
+#include "checkpoint.h"
+#include "runahead.h"
+#include "emuloop.h"
+
+#define NS_FRAME (1000000000L / FRAME_HZ)
+
+void initializeEmuLoop(EmuLoop* loop, CPUState* state, TripleBuffer* frames) {
+    memset(loop, 0, sizeof(EmuLoop));
+    loop->state = state;
+    loop->step = stepMachine;
+    loop->frames = frames;
+    loop->paced = 1;
+    atomic_init(&loop->input1, state->ports.read1);
+    atomic_init(&loop->input2, state->ports.read2);
+    atomic_init(&loop->running, 1);
+    atomic_init(&loop->frame, 0);
+    atomic_init(&loop->turbo, 0);
+    atomic_init(&loop->speed, 0);
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleepUntil(int64_t ns) {
+    struct timespec ts = { ns / 1000000000LL, ns % 1000000000LL };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+// paced runs show every frame, turbo shows every Nth or whatever is current at each display deadline
+static int shouldPublish(EmuLoop* loop, int throttled, uint64_t frame, int64_t now, int64_t* display) {
+    if (throttled)
+        return 1;
+    if (loop->presentEvery > 0)
+        return frame % loop->presentEvery == 0;
+    if (now < *display)
+        return 0;
+    *display = now - *display > NS_FRAME ? now + NS_FRAME : *display + NS_FRAME;
+    return 1;
+}
+
+void* runEmuLoop(void* arg) {
+    EmuLoop* loop = arg;
+    CPUState* state = loop->state;
+    int64_t deadline = nowNs();
+    int64_t display = deadline;
+    int64_t window = deadline;
+    uint64_t windowFrames = 0;
+
+    int64_t started = 0;
+    Metrics* metrics = loop->metrics;
+    RunAhead ahead;
+    initializeRunAhead(&ahead, loop->runAhead);
+
+    while (atomic_load(&loop->running)) {
+        state->ports.read1 = atomic_load(&loop->input1);
+        state->ports.read2 = atomic_load(&loop->input2);
+        if (metrics) {
+            FrameStats stats;
+            int64_t begin = nowNs();
+            runFrameStats(state, loop->step, &stats);
+            recordMetric(metrics, HIST_EMULATE, nowNs() - begin);
+            if (started)
+                recordMetric(metrics, HIST_FRAME, begin - started);
+            started = begin;
+            recordMetric(metrics, HIST_INSTRUCTIONS, stats.instructions);
+            recordMetric(metrics, HIST_CYCLES, stats.cycles);
+            countMetric(metrics, COUNT_FRAMES, 1);
+            countMetric(metrics, COUNT_INSTRUCTIONS, stats.instructions);
+            countMetric(metrics, COUNT_CYCLES, stats.cycles);
+            countMetric(metrics, COUNT_INTERRUPTS, stats.interrupts);
+            if (ahead.frames)
+                lookAhead(state, &ahead, loop->step);
+        } else if (ahead.frames) {
+            runAheadFrame(state, &ahead, loop->step);
+        } else {
+            runFrameWith(state, loop->step);
+        }
+        if (loop->sound)
+            soundFrame(loop->sound, state);
+
+        uint64_t frame = atomic_fetch_add(&loop->frame, 1) + 1;
+        int throttled = loop->paced && !atomic_load(&loop->turbo);
+        int64_t now = nowNs();
+
+        // VRAM snapshot point, a recording keeps every frame even when the display skips
+        if (loop->frames && shouldPublish(loop, throttled, frame, now, &display)) {
+            memcpy(backFrame(loop->frames), ahead.frames ? ahead.vram : &state->mem[VRAM_START], VRAM_SIZE);
+            publishFrame(loop->frames);
+        } else if (loop->frames && metrics) {
+            countMetric(metrics, COUNT_DROPPED, 1);
+        }
+        if (loop->video)
+            queueVideoFrame(loop->video, &state->mem[VRAM_START]);
+        if (loop->checkpoints && frame % loop->checkpointEvery == 0)
+            queueCheckpoint(loop->checkpoints, state, 0, frame);
+
+        // speed multiplier over roughly half a second of wall time
+        windowFrames++;
+        if (now - window >= 500000000LL) {
+            double realtime = (double) windowFrames * 1e9 / ((now - window) * FRAME_HZ);
+            atomic_store(&loop->speed, (unsigned) (realtime * 100 + 0.5));
+            window = now;
+            windowFrames = 0;
+        }
+
+        if (loop->maxFrames && frame >= loop->maxFrames)
+            break;
+        if (state->stopped)
+            break;
+
+        if (throttled) {
+            // a late frame moves the schedule instead of running a burst to catch up
+            deadline += NS_FRAME;
+            if (now - deadline > NS_FRAME) {
+                deadline = now;
+                if (metrics)
+                    countMetric(metrics, COUNT_LATE, 1);
+            }
+            sleepUntil(deadline);
+        } else {
+            deadline = now;
+        }
+    }
+    atomic_store(&loop->running, 0);
+    return NULL;
+}
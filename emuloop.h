@@ -0,0 +1,51 @@
+#ifndef __emuloop_h__
+#define __emuloop_h__
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "cpu.h"
+#include "machine.h"
+#include "triplebuffer.h"
+#include "sound.h"
+#include "video.h"
+#include "metrics.h"
+#include "checkpoint.h"
+#include "runahead.h"
+
+/*
+    The frame loop shared by the windowed and headless builds. It owns
+    the CPU; other threads only touch the atomics. Finished frames' VRAM
+    is published to frames when there is something presenting it, all of
+    them when paced and only some when running unthrottled. With
+    runAhead the published screen is that many frames in the future, see
+    runahead.h. A video writer gets every real frame from the same
+    snapshot point.
+*/
+typedef struct EmuLoop {
+    CPUState* state;
+    StepFn step;
+    TripleBuffer* frames;       // NULL when headless
+    Sound* sound;               // mixed after every frame when set
+    VideoWriter* video;         // queued every frame when set
+    Metrics* metrics;           // frame timings and CPU counts when set
+    Checkpoints* checkpoints;   // queued every checkpointEvery frames when set
+    int checkpointEvery;
+    int runAhead;               // frames the presented screen runs ahead, 0 for none
+    int paced;                  // hold to 60Hz, otherwise run flat out
+    int presentEvery;           // unthrottled, publish every Nth frame, 0 for each 60Hz display deadline
+    uint64_t maxFrames;         // stop after this many, 0 for no limit
+
+    atomic_uchar input1;        // port 1 and 2 bits from the UI thread
+    atomic_uchar input2;
+    atomic_int running;         // cleared to stop the loop
+    atomic_ullong frame;        // frames run so far
+    atomic_int turbo;           // run unthrottled even when paced
+    atomic_uint speed;          // emulated speed over the last half second, hundredths of realtime
+} EmuLoop;
+
+void    initializeEmuLoop(EmuLoop* loop, CPUState* state, TripleBuffer* frames);
+
+// runs until running is cleared, maxFrames is reached or the CPU stops, has a pthread signature
+void*   runEmuLoop(void* loop);
+
+#endif
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "machine.h"
+#include "env.h"
+#include "gamestate.h"
+#include "pool.h"
+
+// port 1 bits
+#define IN_COIN 0x01
+#define IN_P1_START 0x04
+#define IN_ALWAYS 0x08
+#define IN_P1_FIRE 0x10
+#define IN_P1_LEFT 0x20
+#define IN_P1_RIGHT 0x40
+
+static const uint8_t actionBits[ACTION_COUNT] = {
+    0,
+    IN_P1_FIRE,
+    IN_P1_LEFT,
+    IN_P1_RIGHT,
+    IN_P1_LEFT | IN_P1_FIRE,
+    IN_P1_RIGHT | IN_P1_FIRE,
+};
+
+static inline uint32_t xorshift(uint32_t* s) {
+    uint32_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+static void holdInputs(CPUState* state, uint8_t bits, int frames) {
+    state->ports.read1 = IN_ALWAYS | bits;
+    for (int i = 0; i < frames; i++)
+        runFrame(state);
+    state->ports.read1 = IN_ALWAYS;
+}
+
+void setAction(CPUState* state, uint8_t action) {
+    state->ports.read1 = IN_ALWAYS | actionBits[action < ACTION_COUNT ? action : ACTION_NOOP];
+}
+
+void bootGame(CPUState* state) {
+    memset(state->mem, 0, 0x10000);
+    if (!loadInvaders(state)) {
+        printf("Error: can't read the ROM from ./rom\n");
+        exit(1);
+    }
+    holdInputs(state, 0, 60);
+    holdInputs(state, IN_COIN, 4);
+    holdInputs(state, 0, 30);
+    holdInputs(state, IN_P1_START, 4);
+    for (int i = 0; i < 600; i++) {
+        if (gamePlaying(state) && playerReady(state))
+            return;
+        runFrame(state);
+    }
+    printf("Error: game did not start\n");
+    exit(1);
+}
+
+Env* initializeEnv(int count, EnvConfig* config) {
+    Env* env = calloc(1, sizeof(Env));
+    env->count = count;
+    env->config = *config;
+    if (env->config.frameSkip < 1)
+        env->config.frameSkip = 1;
+    if (env->config.downsample != 2 && env->config.downsample != 4 && env->config.downsample != 8)
+        env->config.downsample = 1;
+    if (env->config.step == NULL)
+        env->config.step = stepMachine;
+
+    CPUState* boot = initializeCPU();
+    bootGame(boot);
+    env->pool = initializePool(count, boot);
+    for (int i = 0; i < count; i++)
+        acquireInstance(env->pool);
+    freeCPU(boot);
+
+    env->last = calloc(count, 1);
+    env->rng = malloc(count * sizeof(uint32_t));
+    env->score = malloc(count * sizeof(int32_t));
+    for (int i = 0; i < count; i++)
+        env->rng[i] = (config->seed + i) * 2654435761u | 1;
+    resetEnv(env, -1);
+    return env;
+}
+
+void freeEnv(Env* env) {
+    freePool(env->pool);
+    free(env->last);
+    free(env->rng);
+    free(env->score);
+    free(env);
+}
+
+void resetEnv(Env* env, int index) {
+    if (index < 0) {
+        for (int i = 0; i < env->count; i++)
+            resetEnv(env, i);
+        return;
+    }
+
+    CPUState* state = poolInstance(env->pool, index);
+    resetInstance(env->pool, state);
+    env->last[index] = ACTION_NOOP;
+    env->score[index] = gameScore(state, 0);
+}
+
+void stepEnv(Env* env, const uint8_t* actions, int32_t* rewards, uint8_t* dones) {
+    for (int i = 0; i < env->count; i++) {
+        uint8_t action = actions[i] < ACTION_COUNT ? actions[i] : ACTION_NOOP;
+        if (env->config.sticky > 0 && (xorshift(&env->rng[i]) >> 8) < env->config.sticky * (1 << 24))
+            action = env->last[i];
+        env->last[i] = action;
+
+        CPUState* state = poolInstance(env->pool, i);
+        setAction(state, action);
+        for (int f = 0; f < env->config.frameSkip; f++)
+            runFrameWith(state, env->config.step);
+
+        int32_t now = gameScore(state, 0);
+        rewards[i] = now - env->score[i];
+        env->score[i] = now;
+        dones[i] = !gamePlaying(state);
+    }
+}
+
+int envObsSize(Env* env) {
+    int k = env->config.downsample;
+    if (k == 1)
+        return VRAM_SIZE;
+    return (256 / k) * (224 / k);
+}
+
+/*
+    VRAM holds the screen rotated, each of the 224 columns is 32 bytes
+    running from the bottom of the upright screen to the top. A block of
+    k bits in one byte lands in a single output pixel.
+*/
+static void downsample(uint8_t* vram, uint8_t* out, int k) {
+    int width = 224 / k;
+    uint8_t mask = (1 << k) - 1;
+    memset(out, 0, (256 / k) * width);
+    for (int x = 0; x < 224; x++) {
+        uint8_t* column = &vram[x * 32];
+        int ox = x / k;
+        for (int j = 0; j < 32; j++) {
+            uint8_t b = column[j];
+            if (b == 0)
+                continue;
+            for (int bit = 0; bit < 8; bit += k) {
+                int y = 255 - (j * 8 + bit);
+                out[(y / k) * width + ox] += __builtin_popcount((b >> bit) & mask);
+            }
+        }
+    }
+}
+
+void observeEnv(Env* env, uint8_t* out) {
+    int size = envObsSize(env);
+    for (int i = 0; i < env->count; i++) {
+        uint8_t* vram = poolInstance(env->pool, i)->mem + VRAM_START;
+        if (env->config.downsample == 1)
+            memcpy(out + i * size, vram, VRAM_SIZE);
+        else
+            downsample(vram, out + i * size, env->config.downsample);
+    }
+}
+
+int32_t envScore(Env* env, int index) {
+    return gameScore(poolInstance(env->pool, index), 0);
+}
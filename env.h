@@ -0,0 +1,72 @@
+#ifndef __env_h__
+#define __env_h__
+
+#include <stdint.h>
+#include "cpu.h"
+#include "machine.h"
+#include "pool.h"
+
+// player 1 inputs held for a whole step
+enum {
+    ACTION_NOOP,
+    ACTION_FIRE,
+    ACTION_LEFT,
+    ACTION_RIGHT,
+    ACTION_LEFT_FIRE,
+    ACTION_RIGHT_FIRE,
+    ACTION_COUNT
+};
+
+typedef struct EnvConfig {
+    int frameSkip;          // frames run per step with the action held
+    float sticky;           // chance an env repeats its previous action instead
+    int downsample;         // 1 for raw VRAM bytes, 2, 4 or 8 for lit pixel counts per block
+    uint32_t seed;
+    StepFn step;            // core to run, stepMachine when NULL
+} EnvConfig;
+
+/*
+    N games of player 1 driven step by step from training code. Every env
+    restarts from a game that has just begun. All memory is allocated up
+    front, the machines in one pool whose golden machine is that game, so
+    a step or a reset only touches the emulated machines and the caller's
+    reward and done arrays.
+
+    The envs run one after another rather than through the batch core:
+    games fed different inputs split at almost every branch, and lockstep
+    groups of one lane are slower than the plain interpreter.
+*/
+typedef struct Env {
+    int count;
+    EnvConfig config;
+    InstancePool* pool;     // env i is instance i
+    uint8_t* last;          // previous action per env, for sticky actions
+    uint32_t* rng;          // xorshift state per env
+    int32_t* score;         // score at the end of the previous step
+} Env;
+
+// boots the ROM, drops a coin and waits until the player's ship can move
+void    bootGame(CPUState* state);
+
+// holds action's inputs on port 1, NOOP for anything out of range
+void    setAction(CPUState* state, uint8_t action);
+
+Env*    initializeEnv(int count, EnvConfig* config);
+void    freeEnv(Env* env);
+
+// restarts env index, or every env when index is negative
+void    resetEnv(Env* env, int index);
+
+// runs one step of every env, done is set once the game is over
+void    stepEnv(Env* env, const uint8_t* actions, int32_t* rewards, uint8_t* dones);
+
+// bytes per env written by observeEnv
+int     envObsSize(Env* env);
+
+// writes count * envObsSize bytes, raw VRAM or a downsampled upright image
+void    observeEnv(Env* env, uint8_t* out);
+
+// score in points from the BCD bytes in RAM
+int32_t envScore(Env* env, int index);
+
+#endif
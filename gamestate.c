@@ -0,0 +1,80 @@
+#include <string.h>
+#include "cpu.h"
+#include "gamestate.h"
+
+static inline uint32_t bcd(uint8_t x) {
+    return (x >> 4) * 10 + (x & 0xf);
+}
+
+static inline uint32_t bcdScore(uint8_t* mem, uint16_t addr) {
+    return bcd(mem[addr + 1]) * 100 + bcd(mem[addr]);
+}
+
+uint32_t gameScore(CPUState* state, int player) {
+    return bcdScore(state->mem, player == 1 ? RAM_P2_SCORE : RAM_P1_SCORE);
+}
+
+int gamePlaying(CPUState* state) {
+    return state->mem[RAM_GAME_MODE] == 1;
+}
+
+int playerReady(CPUState* state) {
+    return state->mem[RAM_PLAYER_ALIVE] == 0xff && state->mem[RAM_PLAYER_TIMER] == 0;
+}
+
+// each player has a page of RAM, the game swaps which one RAM_PLAYER_DATA points at
+int shipsLeft(CPUState* state) {
+    return state->mem[state->mem[RAM_PLAYER_DATA] << 8 | PLAYER_SHIPS_LEFT];
+}
+
+void readGameState(CPUState* state, GameState* game) {
+    uint8_t* mem = state->mem;
+    game->score[0] = bcdScore(mem, RAM_P1_SCORE);
+    game->score[1] = bcdScore(mem, RAM_P2_SCORE);
+    game->hiScore = bcdScore(mem, RAM_HI_SCORE);
+    game->credits = bcd(mem[RAM_CREDITS]);
+    game->playing = gamePlaying(state);
+    game->shipsLeft = shipsLeft(state);
+    game->playerAlive = mem[RAM_PLAYER_ALIVE] == 0xff;
+    game->playerReady = playerReady(state);
+    game->playerX = mem[RAM_PLAYER_X];
+    game->shotStatus = mem[RAM_SHOT_STATUS];
+    game->shotX = mem[RAM_SHOT_X];
+    game->shotY = mem[RAM_SHOT_Y];
+    // 0xff until the first rack is set up
+    game->aliensLeft = mem[RAM_NUM_ALIENS] == 0xff ? 0 : mem[RAM_NUM_ALIENS];
+    game->rackX = mem[RAM_REF_ALIEN_X];
+    game->rackY = mem[RAM_REF_ALIEN_Y];
+
+    // one byte per alien, non zero while it's alive
+    uint8_t* table = &mem[mem[RAM_PLAYER_DATA] << 8];
+    for (int i = 0; i < ALIEN_ROWS * ALIEN_COLS; i++)
+        game->aliens[i / ALIEN_COLS][i % ALIEN_COLS] = table[i] != 0;
+}
+
+uint32_t updateGameState(CPUState* state, GameState* game) {
+    GameState prev = *game;
+    readGameState(state, game);
+
+    uint32_t changed = 0;
+    if (memcmp(prev.score, game->score, sizeof(game->score)) != 0)
+        changed |= GAME_SCORE;
+    if (prev.hiScore != game->hiScore)
+        changed |= GAME_HI_SCORE;
+    if (prev.credits != game->credits)
+        changed |= GAME_CREDITS;
+    if (prev.playing != game->playing)
+        changed |= GAME_MODE;
+    if (prev.shipsLeft != game->shipsLeft)
+        changed |= GAME_SHIPS;
+    if (prev.playerAlive != game->playerAlive || prev.playerReady != game->playerReady
+            || prev.playerX != game->playerX)
+        changed |= GAME_PLAYER;
+    if (prev.shotStatus != game->shotStatus || prev.shotX != game->shotX || prev.shotY != game->shotY)
+        changed |= GAME_SHOT;
+    if (prev.rackX != game->rackX || prev.rackY != game->rackY)
+        changed |= GAME_RACK;
+    if (prev.aliensLeft != game->aliensLeft || memcmp(prev.aliens, game->aliens, sizeof(game->aliens)) != 0)
+        changed |= GAME_ALIENS;
+    return changed;
+}
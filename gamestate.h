@@ -0,0 +1,73 @@
+#ifndef __gamestate_h__
+#define __gamestate_h__
+
+#include <stdint.h>
+#include "cpu.h"
+#include "machine.h"
+
+// fixed locations the ROM keeps its state in
+#define RAM_REF_ALIEN_Y 0x2009     // bottom left alien of the rack
+#define RAM_REF_ALIEN_X 0x200a
+#define RAM_PLAYER_TIMER 0x2011    // counts down before the ship can move
+#define RAM_PLAYER_ALIVE 0x2015    // 0xff while the ship is on screen
+#define RAM_PLAYER_X 0x201b
+#define RAM_SHOT_STATUS 0x2025     // 0 ready, 1 fired, 2 moving, 3+ exploding
+#define RAM_SHOT_Y 0x2029
+#define RAM_SHOT_X 0x202a
+#define RAM_PLAYER_DATA 0x2067     // high byte of the current player's alien table
+#define RAM_NUM_ALIENS 0x2082
+#define RAM_CREDITS 0x20eb         // BCD
+#define RAM_GAME_MODE 0x20ef       // 1 while a game is being played
+#define RAM_HI_SCORE 0x20f4        // scores are two BCD bytes, low byte first
+#define RAM_P1_SCORE 0x20f8
+#define RAM_P2_SCORE 0x20fa
+
+// offsets into the current player's page, 0x21xx or 0x22xx
+#define PLAYER_SHIPS_LEFT 0xff     // spare ships after the current one
+
+#define ALIEN_ROWS 5
+#define ALIEN_COLS 11
+
+// decoded view of the current game, alien rows run from the bottom of the rack up
+typedef struct GameState {
+    uint32_t score[2];
+    uint32_t hiScore;
+    uint8_t credits;
+    uint8_t playing;
+    uint8_t shipsLeft;
+    uint8_t playerAlive;
+    uint8_t playerReady;    // alive and past the start delay
+    uint8_t playerX;
+    uint8_t shotStatus;
+    uint8_t shotX;
+    uint8_t shotY;
+    uint8_t aliensLeft;
+    uint8_t rackX;
+    uint8_t rackY;
+    uint8_t aliens[ALIEN_ROWS][ALIEN_COLS];
+} GameState;
+
+// bits returned by updateGameState
+enum {
+    GAME_SCORE = 1 << 0,
+    GAME_HI_SCORE = 1 << 1,
+    GAME_CREDITS = 1 << 2,
+    GAME_MODE = 1 << 3,
+    GAME_SHIPS = 1 << 4,
+    GAME_PLAYER = 1 << 5,   // alive, ready or x
+    GAME_SHOT = 1 << 6,
+    GAME_RACK = 1 << 7,     // rack position
+    GAME_ALIENS = 1 << 8,   // count or grid
+};
+
+uint32_t    gameScore(CPUState* state, int player);
+int         gamePlaying(CPUState* state);
+int         playerReady(CPUState* state);
+int         shipsLeft(CPUState* state);
+
+void        readGameState(CPUState* state, GameState* game);
+
+// re-reads game and returns which fields changed since it was last read
+uint32_t    updateGameState(CPUState* state, GameState* game);
+
+#endif
@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "cpu.h"
+#include "machine.h"
+#include "memmap.h"
+#include "access.h"
+#include "gdbstub.h"
+
+#define PACKET_SIZE 4096
+#define GDB_REGS 13         // z80 layout, only the first 6 exist here
+
+enum { STOP_NONE, STOP_ATTACH, STOP_INTERRUPT };
+
+atomic_int debugArmed;
+static Debugger* active;
+
+static inline int bitSet(uint8_t* bits, uint16_t addr) {
+    return bits[addr >> 3] >> (addr & 7) & 1;
+}
+
+static inline void setBits(uint8_t* bits, uint16_t addr, int len, int on) {
+    for (int i = 0; i < len; i++, addr++) {
+        if (on)
+            bits[addr >> 3] |= 1 << (addr & 7);
+        else
+            bits[addr >> 3] &= ~(1 << (addr & 7));
+    }
+}
+
+static const char hexDigits[] = "0123456789abcdef";
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static uint32_t parseHex(char** p) {
+    uint32_t x = 0;
+    int d;
+    while ((d = hexValue(**p)) >= 0) {
+        x = x << 4 | d;
+        (*p)++;
+    }
+    return x;
+}
+
+// 16 bit register as GDB sends it, low byte first
+static char* putWord(char* out, uint16_t x) {
+    *out++ = hexDigits[(x >> 4) & 15];
+    *out++ = hexDigits[x & 15];
+    *out++ = hexDigits[(x >> 12) & 15];
+    *out++ = hexDigits[(x >> 8) & 15];
+    return out;
+}
+
+static uint16_t getWord(char* in) {
+    return hexValue(in[0]) << 4 | hexValue(in[1]) | hexValue(in[2]) << 12 | hexValue(in[3]) << 8;
+}
+
+static uint16_t getRegister(CPUState* state, int n) {
+    syncFlags(state);
+    uint8_t f = state->flags.s << 7 | state->flags.z << 6 | state->flags.ac << 4 |
+                state->flags.p << 2 | 1 << 1 | state->flags.c;
+    switch (n) {
+        case 0: return state->a << 8 | f;
+        case 1: return state->b << 8 | state->c;
+        case 2: return state->d << 8 | state->e;
+        case 3: return state->h << 8 | state->l;
+        case 4: return state->sp;
+        case 5: return state->pc;
+    }
+    return 0;
+}
+
+static void setRegister(CPUState* state, int n, uint16_t x) {
+    switch (n) {
+        case 0:
+            state->a = x >> 8;
+#ifdef LAZY_FLAGS
+            state->lazy.op = LAZY_NONE;
+#endif
+            state->flags.s = (x >> 7) & 1;
+            state->flags.z = (x >> 6) & 1;
+            state->flags.ac = (x >> 4) & 1;
+            state->flags.p = (x >> 2) & 1;
+            state->flags.c = x & 1;
+            break;
+        case 1: state->b = x >> 8; state->c = x; break;
+        case 2: state->d = x >> 8; state->e = x; break;
+        case 3: state->h = x >> 8; state->l = x; break;
+        case 4: state->sp = x; break;
+        case 5: state->pc = x; break;
+    }
+}
+
+static void sendPacket(Debugger* dbg, const char* data) {
+    char buf[PACKET_SIZE + 4];
+    uint8_t sum = 0;
+    int n = 0;
+    buf[n++] = '$';
+    for (const char* c = data; *c; c++) {
+        buf[n++] = *c;
+        sum += *c;
+    }
+    buf[n++] = '#';
+    buf[n++] = hexDigits[sum >> 4];
+    buf[n++] = hexDigits[sum & 15];
+    send(dbg->client, buf, n, MSG_NOSIGNAL);
+}
+
+// the next packet's payload, acked, -1 once the connection is gone
+static int getPacket(Debugger* dbg, char* out) {
+    char c;
+    for (;;) {
+        do {
+            if (recv(dbg->client, &c, 1, 0) != 1)
+                return -1;
+        } while (c != '$');     // acks and a ^C sent while already stopped
+
+        int n = 0;
+        uint8_t sum = 0;
+        for (;;) {
+            if (recv(dbg->client, &c, 1, 0) != 1)
+                return -1;
+            if (c == '#')
+                break;
+            if (n < PACKET_SIZE - 1)
+                out[n++] = c;
+            sum += c;
+        }
+        char check[2];
+        if (recv(dbg->client, check, 2, MSG_WAITALL) != 2)
+            return -1;
+        out[n] = 0;
+        if ((hexValue(check[0]) << 4 | hexValue(check[1])) == sum) {
+            send(dbg->client, "+", 1, MSG_NOSIGNAL);
+            return n;
+        }
+        send(dbg->client, "-", 1, MSG_NOSIGNAL);
+    }
+}
+
+static void setRunning(Debugger* dbg, int running) {
+    pthread_mutex_lock(&dbg->lock);
+    dbg->running = running;
+    dbg->runs += running;
+    pthread_cond_broadcast(&dbg->changed);
+    pthread_mutex_unlock(&dbg->lock);
+}
+
+static void detach(Debugger* dbg) {
+    atomic_store(&debugArmed, 0);
+    pthread_mutex_lock(&dbg->lock);
+    close(dbg->client);
+    dbg->client = -1;
+    dbg->stepping = 0;
+    pthread_cond_broadcast(&dbg->changed);
+    pthread_mutex_unlock(&dbg->lock);
+}
+
+static void insertPoint(Debugger* dbg, CPUState* state, char* args, int on) {
+    int type = parseHex(&args);
+    args++;
+    uint16_t addr = parseHex(&args);
+    args++;
+    int len = parseHex(&args);
+    if (len < 1)
+        len = 1;
+
+    if (type == 0 || type == 1) {
+        setBits(dbg->breakpoints, addr, 1, on);
+        return;
+    }
+    for (int i = 0; i < len; i++) {
+        uint16_t byte = homeAddress(state, addr + i);
+        if (type == 2 || type == 4)
+            setBits(dbg->watchWrite, byte, 1, on);
+        if (type == 3 || type == 4)
+            setBits(dbg->watchRead, byte, 1, on);
+    }
+    dbg->watchpoints += on ? 1 : -1;
+}
+
+/*
+    Talks to GDB with the target halted, returns once it says continue or
+    step. reply is the stop reason to report, NULL if GDB hasn't asked yet.
+*/
+static void stopTarget(Debugger* dbg, CPUState* state, const char* reply) {
+    char packet[PACKET_SIZE];
+    char out[PACKET_SIZE];
+
+    setRunning(dbg, 0);
+    if (reply)
+        sendPacket(dbg, reply);
+
+    for (;;) {
+        if (getPacket(dbg, packet) < 0) {
+            detach(dbg);
+            break;
+        }
+        char* args = packet + 1;
+        out[0] = 0;
+
+        switch (packet[0]) {
+            case '?':
+                strcpy(out, "S05");
+                break;
+            case 'g': {
+                char* p = out;
+                for (int i = 0; i < GDB_REGS; i++)
+                    p = putWord(p, getRegister(state, i));
+                *p = 0;
+            } break;
+            case 'G':
+                for (size_t i = 0; i < 6 && strlen(args) >= (i + 1) * 4; i++)
+                    setRegister(state, i, getWord(args + i * 4));
+                strcpy(out, "OK");
+                break;
+            case 'p': {
+                int n = parseHex(&args);
+                *putWord(out, getRegister(state, n)) = 0;
+            } break;
+            case 'P': {
+                int n = parseHex(&args);
+                if (*args == '=' && strlen(args + 1) >= 4)
+                    setRegister(state, n, getWord(args + 1));
+                strcpy(out, "OK");
+            } break;
+            case 'm': {
+                uint16_t addr = parseHex(&args);
+                args++;
+                int len = parseHex(&args);
+                if (len > PACKET_SIZE / 2 - 1)
+                    len = PACKET_SIZE / 2 - 1;
+                // through the map, so mirrors read as the CPU sees them
+                for (int i = 0; i < len; i++) {
+                    uint8_t b = readByte(state, addr + i);
+                    out[i * 2] = hexDigits[b >> 4];
+                    out[i * 2 + 1] = hexDigits[b & 15];
+                }
+                out[len * 2] = 0;
+            } break;
+            case 'M': {
+                uint16_t addr = parseHex(&args);
+                args++;
+                int len = parseHex(&args);
+                args++;
+                // ROM drops writes here just as it does for the CPU
+                for (int i = 0; i < len && args[i * 2] && args[i * 2 + 1]; i++)
+                    writeByte(state, addr + i, hexValue(args[i * 2]) << 4 | hexValue(args[i * 2 + 1]));
+                strcpy(out, "OK");
+            } break;
+            case 'c':
+            case 's':
+                if (*args)
+                    state->pc = parseHex(&args);
+                dbg->stepping = packet[0] == 's';
+                setRunning(dbg, 1);
+                return;
+            case 'Z':
+            case 'z':
+                insertPoint(dbg, state, args, packet[0] == 'Z');
+                strcpy(out, "OK");
+                break;
+            case 'D':
+                sendPacket(dbg, "OK");
+                detach(dbg);
+                setRunning(dbg, 1);
+                return;
+            case 'k':
+                detach(dbg);
+                setRunning(dbg, 1);
+                return;
+            case 'H':
+                strcpy(out, "OK");
+                break;
+            case 'q':
+                if (strncmp(packet, "qSupported", 10) == 0)
+                    snprintf(out, sizeof(out), "PacketSize=%x", PACKET_SIZE);
+                else if (strcmp(packet, "qAttached") == 0)
+                    strcpy(out, "1");
+                else if (strcmp(packet, "qC") == 0)
+                    strcpy(out, "QC1");
+                break;
+        }
+        sendPacket(dbg, out);
+    }
+    setRunning(dbg, 1);
+}
+
+// true if the instruction touched a watched byte, which goes in reply by its home address, see memmap.h
+static int watchHit(Debugger* dbg, AccessSite* site, CPUState* state, char* reply) {
+    MemAccess acc;
+    decodeAccess(site, state->sp, &acc);
+    for (int i = 0; i < acc.writes; i++) {
+        uint16_t byte = homeAddress(state, acc.write[i]);
+        if (bitSet(dbg->watchWrite, byte)) {
+            sprintf(reply, "T05%swatch:%04x;", bitSet(dbg->watchRead, byte) ? "a" : "", byte);
+            return 1;
+        }
+    }
+    for (int i = 0; i < acc.reads; i++) {
+        uint16_t byte = homeAddress(state, acc.read[i]);
+        if (bitSet(dbg->watchRead, byte)) {
+            sprintf(reply, "T05%swatch:%04x;", bitSet(dbg->watchWrite, byte) ? "a" : "r", byte);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int debugStep(Debugger* dbg, CPUState* state) {
+    int stop = atomic_exchange(&dbg->stopRequested, STOP_NONE);
+    if (stop == STOP_ATTACH)
+        stopTarget(dbg, state, NULL);
+    else if (stop == STOP_INTERRUPT)
+        stopTarget(dbg, state, "S02");
+    else if (bitSet(dbg->breakpoints, state->pc))
+        stopTarget(dbg, state, "S05");
+    if (!atomic_load(&debugArmed))
+        return dbg->inner(state);
+
+    AccessSite site;
+    if (dbg->watchpoints)
+        noteAccessSite(state, &site);
+    int cycles = dbg->inner(state);
+
+    char reply[32];
+    if (dbg->watchpoints && watchHit(dbg, &site, state, reply)) {
+        stopTarget(dbg, state, reply);
+    } else if (dbg->stepping) {
+        dbg->stepping = 0;
+        stopTarget(dbg, state, "S05");
+    }
+    return cycles;
+}
+
+int stepDebug(CPUState* state) {
+    if (!atomic_load_explicit(&debugArmed, memory_order_relaxed))
+        return active->inner(state);
+    return debugStep(active, state);
+}
+
+/*
+    Accepts one debugger at a time and halts the target for it. While the
+    target runs, a readable socket can only be a ^C, so this thread asks
+    for a stop and leaves the byte for the emulation thread to read.
+*/
+static void* watcherThread(void* arg) {
+    Debugger* dbg = arg;
+    for (;;) {
+        int fd = accept(dbg->listener, NULL, NULL);
+        if (fd < 0)
+            continue;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        pthread_mutex_lock(&dbg->lock);
+        dbg->client = fd;
+        dbg->running = 1;
+        pthread_mutex_unlock(&dbg->lock);
+        atomic_store(&dbg->stopRequested, STOP_ATTACH);
+        atomic_store(&debugArmed, 1);
+
+        pthread_mutex_lock(&dbg->lock);
+        while (dbg->client >= 0) {
+            // holds the lock except while polling, so running can't change under the poll
+            while (dbg->client >= 0 && (!dbg->running || atomic_load(&dbg->stopRequested) != STOP_NONE))
+                pthread_cond_wait(&dbg->changed, &dbg->lock);
+            if (dbg->client < 0)
+                break;
+            // a target that stopped and was continued during the poll may
+            // have read what woke it, so only the same run's bytes count
+            struct pollfd p = { dbg->client, POLLIN, 0 };
+            unsigned run = dbg->runs;
+            pthread_mutex_unlock(&dbg->lock);
+            int ready = poll(&p, 1, 100);
+            pthread_mutex_lock(&dbg->lock);
+            if (ready > 0 && dbg->running && dbg->runs == run && dbg->client >= 0) {
+                atomic_store(&dbg->stopRequested, STOP_INTERRUPT);
+                while (dbg->running && dbg->client >= 0)
+                    pthread_cond_wait(&dbg->changed, &dbg->lock);
+            }
+        }
+        pthread_mutex_unlock(&dbg->lock);
+    }
+    return NULL;
+}
+
+Debugger* startDebugger(int port, StepFn inner) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    Debugger* dbg = calloc(1, sizeof(Debugger));
+    dbg->inner = inner;
+    dbg->listener = fd;
+    dbg->client = -1;
+    pthread_mutex_init(&dbg->lock, NULL);
+    pthread_cond_init(&dbg->changed, NULL);
+    active = dbg;
+    pthread_create(&dbg->thread, NULL, watcherThread, dbg);
+    return dbg;
+}
@@ -0,0 +1,47 @@
+#ifndef __gdbstub_h__
+#define __gdbstub_h__
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "cpu.h"
+#include "machine.h"
+
+/*
+    GDB remote serial protocol over TCP on 127.0.0.1. Registers follow
+    GDB's z80 layout (set architecture z80): AF BC DE HL SP PC, then
+    IX IY, the shadow set and IR, which read as 0. F is in the 8080's
+    PUSH PSW bit order. Supports g/G/p/P, m/M, s/c, Z0-Z4 and ^C.
+
+    stepDebug only tests debugArmed until a debugger connects, then
+    checks the breakpoint bitmap each instruction and decodes memory
+    accesses while any watchpoint is set. When the target stops, the
+    emulation thread itself talks to GDB until told to continue.
+*/
+extern atomic_int debugArmed;
+
+typedef struct Debugger {
+    uint8_t breakpoints[0x10000 / 8];
+    uint8_t watchRead[0x10000 / 8];
+    uint8_t watchWrite[0x10000 / 8];
+    int watchpoints;            // inserted, memory accesses are only decoded while non zero
+    StepFn inner;
+
+    int listener;
+    int client;                 // -1 when nothing is attached
+    atomic_int stopRequested;   // STOP_* to halt before the next instruction
+    int stepping;               // stop again after one instruction
+
+    // the watcher thread polls for ^C only while the target runs
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int running;
+    unsigned runs;              // bumped on every continue or step
+} Debugger;
+
+// listens on port, runs instructions through inner, NULL if the port can't be bound
+Debugger*   startDebugger(int port, StepFn inner);
+int         stepDebug(CPUState* state);
+
+#endif
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "machine.h"
+#include "memmap.h"
+#include "disassembler.h"
+#include "invaders.h"
+
+#define STATE_MAGIC 0x53544149u     // "IATS"
+#define IN_ALWAYS 0x08
+
+struct Invaders {
+    CPUState* cpu;
+    SaveState power;                // right after the ROM was loaded
+    uint64_t frame;
+};
+
+// what saveInvaders writes, the frame count travels with the machine
+typedef struct InvadersState {
+    uint32_t magic;
+    uint32_t size;
+    uint64_t frame;
+    SaveState save;
+} InvadersState;
+
+static const char* romFiles[4] = { "invaders.h", "invaders.g", "invaders.f", "invaders.e" };
+
+int invadersVersion(void) {
+    return INVADERS_API_VERSION;
+}
+
+Invaders* createInvaders(const char* romDir) {
+    Invaders* inv = calloc(1, sizeof(Invaders));
+    inv->cpu = initializeCPU();
+    for (int i = 0; i < 4; i++) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", romDir, romFiles[i]);
+        if (!loadFile(inv->cpu, path, i * 0x800)) {
+            freeInvaders(inv);
+            return NULL;
+        }
+    }
+    inv->cpu->ports.read1 = IN_ALWAYS;
+    saveState(inv->cpu, &inv->power);
+    return inv;
+}
+
+void freeInvaders(Invaders* inv) {
+    freeCPU(inv->cpu);
+    free(inv);
+}
+
+void resetInvaders(Invaders* inv) {
+    loadState(inv->cpu, &inv->power);
+    inv->frame = 0;
+}
+
+void setInvadersInputs(Invaders* inv, uint8_t port1, uint8_t port2) {
+    inv->cpu->ports.read1 = port1 | IN_ALWAYS;
+    inv->cpu->ports.read2 = port2;
+}
+
+int runInvadersFrame(Invaders* inv) {
+    if (inv->cpu->stopped == CPU_RUNNING) {
+        runFrame(inv->cpu);
+        inv->frame++;
+    }
+    return invadersStatus(inv);
+}
+
+int invadersStatus(Invaders* inv) {
+    switch (inv->cpu->stopped) {
+        case CPU_HALTED: return INVADERS_HALTED;
+        case CPU_FAULTED: return INVADERS_FAULTED;
+    }
+    return INVADERS_RUNNING;
+}
+
+uint64_t invadersFrame(Invaders* inv) {
+    return inv->frame;
+}
+
+const uint8_t* invadersVRAM(Invaders* inv) {
+    return &inv->cpu->mem[VRAM_START];
+}
+
+uint8_t readInvaders(Invaders* inv, uint16_t addr) {
+    return readByte(inv->cpu, addr);
+}
+
+int disassembleInvaders(Invaders* inv, uint16_t addr, FILE* out) {
+    uint8_t code[3];
+    for (int i = 0; i < 3; i++)
+        code[i] = readByte(inv->cpu, addr + i);
+    int size = Disassemble8080Op(out, code, addr);
+    if (out)
+        fprintf(out, "\n");
+    return size;
+}
+
+size_t invadersStateSize(void) {
+    return sizeof(InvadersState);
+}
+
+void saveInvaders(Invaders* inv, void* state) {
+    InvadersState s;
+    s.magic = STATE_MAGIC;
+    s.size = sizeof(InvadersState);
+    s.frame = inv->frame;
+    saveState(inv->cpu, &s.save);
+    memcpy(state, &s, sizeof(s));
+}
+
+int restoreInvaders(Invaders* inv, const void* state) {
+    InvadersState s;
+    memcpy(&s, state, sizeof(s));
+    if (s.magic != STATE_MAGIC || s.size != sizeof(InvadersState))
+        return 0;
+    loadState(inv->cpu, &s.save);
+    inv->frame = s.frame;
+    return 1;
+}
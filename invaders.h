@@ -0,0 +1,72 @@
+#ifndef __invaders_h__
+#define __invaders_h__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+    The emulator core as a library: the 8080, the cabinet's memory map
+    and I/O ports and the disassembler, without SDL or a main. A machine
+    is opaque, so a harness built against this header keeps working when
+    the internals change. INVADERS_API_VERSION only goes up when this
+    header does. Build libinvaders.a with make lib.
+*/
+#define INVADERS_API_VERSION 2
+
+#define INVADERS_VRAM_SIZE 0x1c00   // 224 columns of 256 pixels, bottom to top, bit 0 lowest
+
+// port 1 bits, bit 3 is held high by the library
+#define INVADERS_COIN 0x01
+#define INVADERS_P2_START 0x02
+#define INVADERS_P1_START 0x04
+#define INVADERS_P1_FIRE 0x10
+#define INVADERS_P1_LEFT 0x20
+#define INVADERS_P1_RIGHT 0x40
+
+// port 2 bits, the rest are DIP switches
+#define INVADERS_P2_FIRE 0x10
+#define INVADERS_P2_LEFT 0x20
+#define INVADERS_P2_RIGHT 0x40
+
+// what runInvadersFrame returns, the machine never exits the host
+enum {
+    INVADERS_RUNNING,
+    INVADERS_HALTED,        // ran HLT, which the real ROM never does
+    INVADERS_FAULTED,       // hit an opcode the CPU doesn't implement
+};
+
+typedef struct Invaders Invaders;
+
+// the INVADERS_API_VERSION the library was built with
+int             invadersVersion(void);
+
+// powered on, NULL unless invaders.h, .g, .f and .e can be read whole from romDir
+Invaders*       createInvaders(const char* romDir);
+void            freeInvaders(Invaders* inv);
+
+// back to power on in place, no allocation
+void            resetInvaders(Invaders* inv);
+
+void            setInvadersInputs(Invaders* inv, uint8_t port1, uint8_t port2);
+
+// a stopped machine stays stopped until it's reset or restored, and runs no more frames
+int             runInvadersFrame(Invaders* inv);
+int             invadersStatus(Invaders* inv);
+
+// frames run since power on
+uint64_t        invadersFrame(Invaders* inv);
+const uint8_t*  invadersVRAM(Invaders* inv);
+
+// a byte as the CPU sees it, through the mirrors
+uint8_t         readInvaders(Invaders* inv, uint16_t addr);
+
+// the instruction at addr as a line of text, or nothing when out is NULL, returns its length in bytes
+int             disassembleInvaders(Invaders* inv, uint16_t addr, FILE* out);
+
+// states only restore into a library built from the same sources
+size_t          invadersStateSize(void);
+void            saveInvaders(Invaders* inv, void* state);
+int             restoreInvaders(Invaders* inv, const void* state);
+
+#endif
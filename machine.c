@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "machine.h"
+#include "memmap.h"
+
+// handles read3 for shift register read
+uint8_t machineIN(CPUState* state, uint8_t port) {
+    uint8_t res = 0;
+    switch (port) {
+        case 1: res = state->ports.read1; break;
+        case 2: res = state->ports.read2; break;
+        case 3: {
+            uint16_t shift_val = state->ports.read3;
+            res = shift_val >> (8- state->ports.write2) & 0xff; 
+        } break;
+    }
+    return res;
+}
+
+// sets shift register accordingly, latches the sound bits on 3 and 5
+void machineOUT(CPUState* state, uint8_t port) {
+    switch (port) {
+        case 2: state->ports.write2 = state->a & 0x7; break;
+        case 3: {
+            state->ports.rising3 |= state->a & ~state->ports.write3;
+            state->ports.write3 = state->a;
+        } break;
+        case 4: {
+            // grab bit 15..8 of shift register
+            uint8_t shift1 = state->ports.read3 >> 8;
+            state->ports.read3 = state->a << 8 | shift1;
+        } break;
+        case 5: {
+            state->ports.rising5 |= state->a & ~state->ports.write5;
+            state->ports.write5 = state->a;
+        } break;
+    }
+}
+
+CPUState* initializeCPU() {
+    CPUState* cpu = (CPUState*) calloc(1,sizeof(CPUState));
+    cpu->mem = calloc(1, 0x10000); // 64KB memory, zeroed so instances start identical
+    cpu->map = &invadersMap;
+    return cpu;
+}
+
+void freeCPU(CPUState* cpu) {
+    free(cpu->mem);
+    free(cpu);
+}
+
+int loadFile(CPUState* state, const char* file, uint32_t pos) {
+    FILE *fp = fopen(file, "rb");
+    if (fp == NULL)
+        return 0;
+
+    fseek(fp,0L,SEEK_END);
+    long fsize = ftell(fp);
+    fseek(fp,0L,SEEK_SET);
+
+    int ok = fsize >= 0 && pos + fsize <= 0x10000 &&
+        fread(&state->mem[pos], 1, fsize, fp) == (size_t) fsize;
+    fclose(fp);
+    return ok;
+}
+
+int loadInvaders(CPUState* state) {
+    return loadFile(state, "./rom/invaders.h", 0x0000) &&
+        loadFile(state, "./rom/invaders.g", 0x0800) &&
+        loadFile(state, "./rom/invaders.f", 0x1000) &&
+        loadFile(state, "./rom/invaders.e", 0x1800);
+}
+
+void saveState(CPUState* state, SaveState* save) {
+    syncFlags(state);
+    save->regs = *state;
+    memcpy(save->ram, &state->mem[RAM_START], RAM_SIZE);
+}
+
+// keeps state's own memory and map, only RAM is copied back
+void loadState(CPUState* state, SaveState* save) {
+    uint8_t* mem = state->mem;
+    const MemoryMap* map = state->map;
+    *state = save->regs;
+    state->mem = mem;
+    state->map = map;
+    memcpy(&state->mem[RAM_START], save->ram, RAM_SIZE);
+}
+
+#define STATE_MAGIC "SISTATE"
+
+int saveStateFile(CPUState* state, const char* path) {
+    SaveState save;
+    saveState(state, &save);
+    FILE* f = fopen(path, "wb");
+    if (f == NULL)
+        return 0;
+    uint32_t size = sizeof(SaveState);
+    fwrite(STATE_MAGIC, 1, sizeof(STATE_MAGIC), f);
+    fwrite(&size, sizeof(size), 1, f);
+    int ok = fwrite(&save, sizeof(save), 1, f) == 1;
+    fclose(f);
+    return ok;
+}
+
+int loadStateFile(CPUState* state, const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+        return 0;
+    char magic[sizeof(STATE_MAGIC)];
+    uint32_t size = 0;
+    SaveState save;
+    int ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && memcmp(magic, STATE_MAGIC, sizeof(magic)) == 0 &&
+        fread(&size, sizeof(size), 1, f) == 1 && size == sizeof(SaveState) &&
+        fread(&save, sizeof(save), 1, f) == 1;
+    fclose(f);
+    if (ok)
+        loadState(state, &save);
+    return ok;
+}
+
+// IN and OUT go to the machine, everything else to the cpu
+int stepMachine(CPUState* state) {
+    unsigned char* opcode = &state->mem[state->pc];
+    if (*opcode == 0xdb) { // IN D8
+        state->a = machineIN(state, opcode[1]);
+        state->pc += 2;
+        return cycles8080[0xdb];
+    } else if (*opcode == 0xd3) { // OUT D8
+        machineOUT(state, opcode[1]);
+        state->pc += 2;
+        return cycles8080[0xd3];
+    }
+    return EmulateCPU(state);
+}
+
+// one 60Hz frame: RST 1 when the beam hits mid-screen, RST 2 at vblank
+static inline void frameWith(CPUState* state, StepFn step, FrameStats* stats) {
+    int cycles = 0, steps = 0, total = 0, interrupts = 0;
+    while (cycles < CYCLES_HALF_FRAME) {
+        cycles += step(state);
+        steps++;
+    }
+    // a stopped CPU spins on its HLT or bad opcode until the host notices
+    if (state->int_enable && !state->stopped) {
+        generateInterrupt(state, 0x08);
+        interrupts++;
+    }
+
+    total = cycles;
+    cycles -= CYCLES_HALF_FRAME;
+    while (cycles < CYCLES_HALF_FRAME) {
+        int n = step(state);
+        cycles += n;
+        total += n;
+        steps++;
+    }
+    if (state->int_enable && !state->stopped) {
+        generateInterrupt(state, 0x10);
+        interrupts++;
+    }
+
+    // constant folded away when called without stats
+    if (stats) {
+        stats->instructions = steps;
+        stats->cycles = total;
+        stats->interrupts = interrupts;
+    }
+}
+
+void runFrameWith(CPUState* state, StepFn step) {
+    frameWith(state, step, NULL);
+}
+
+void runFrameStats(CPUState* state, StepFn step, FrameStats* stats) {
+    frameWith(state, step, stats);
+}
+
+void runFrame(CPUState* state) {
+    runFrameWith(state, stepMachine);
+}
@@ -0,0 +1,55 @@
+#ifndef __machine_h__
+#define __machine_h__
+
+#include <stdint.h>
+#include "cpu.h"
+
+#define CLOCK_HZ 2000000
+#define FRAME_HZ 60
+#define CYCLES_FRAME (CLOCK_HZ / FRAME_HZ)
+#define CYCLES_HALF_FRAME (CYCLES_FRAME / 2)
+
+// everything above the ROM, work RAM then VRAM from 0x2400
+#define RAM_START 0x2000
+#define RAM_SIZE 0x2000
+#define VRAM_START 0x2400
+#define VRAM_SIZE 0x1c00    // 224 columns of 256 pixels, one bit each
+
+// registers and RAM, enough to resume exactly since the ROM never changes
+typedef struct SaveState {
+    CPUState regs;
+    uint8_t ram[RAM_SIZE];
+} SaveState;
+
+// what one frame ran, for metrics
+typedef struct FrameStats {
+    uint32_t instructions;
+    uint32_t cycles;
+    uint32_t interrupts;
+} FrameStats;
+
+// steps one instruction, returns clock cycles taken
+typedef int (*StepFn)(CPUState* state);
+
+CPUState*   initializeCPU();
+void        freeCPU(CPUState* cpu);
+// 0 if the file can't be read whole or doesn't fit above pos
+int         loadFile(CPUState* state, const char* file, uint32_t pos);
+int         loadInvaders(CPUState* state);
+
+uint8_t     machineIN(CPUState* state, uint8_t port);
+void        machineOUT(CPUState* state, uint8_t port);
+
+void        saveState(CPUState* state, SaveState* save);
+void        loadState(CPUState* state, SaveState* save);
+
+// a SaveState on disk, only readable by a build with the same CPUState layout
+int         saveStateFile(CPUState* state, const char* path);
+int         loadStateFile(CPUState* state, const char* path);
+
+int         stepMachine(CPUState* state);
+void        runFrame(CPUState* state);
+void        runFrameWith(CPUState* state, StepFn step);
+void        runFrameStats(CPUState* state, StepFn step, FrameStats* stats);
+
+#endif
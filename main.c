@@ -1,167 +1,430 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <SDL2/SDL.h>
-#include "cpu.h"
-#include "disassembler.h"
-
-#define SCREEN_WIDTH 256
-#define SCREEN_HEIGHT 224 
-#define TICK (1000.0/60.0)
-#define CYCLES_MS 2000
-#define CYCLES_TICK (TICK * CYCLES_MS)
-
-SDL_Window* window;
-SDL_Surface* surface, *winsurface;
-
-// handles read3 for shift register read
-uint8_t machineIN(CPUState* state, uint8_t port) {
-    uint8_t res;
-    switch (port) {
-        case 3: {
-            uint16_t shift_val = state->ports.read3;
-            res = shift_val >> (8- state->ports.write2) & 0xff; 
-        } break;
-    }
-    return res;
-}
-
-// sets shift register accordingly
-void machineOUT(CPUState* state, uint8_t port) {
-    switch (port) {
-        case 2: state->ports.write2 = state->a & 0x7; break;
-        case 4: {
-            // grab bit 15..8 of shift register
-            uint8_t shift1 = state->ports.read3 >> 8;
-            state->ports.read3 = state->a << 8 | shift1;
-        } break;
-    }
-}
-
-CPUState* initializeCPU() {
-    CPUState* cpu = (CPUState*) calloc(1,sizeof(CPUState));
-    cpu->mem = malloc(0x10000); // 64KB memory
-    return cpu;
-}
-
-void loadFile(CPUState* state, char* file, uint32_t pos) {
-    FILE *fp = fopen(file, "rb");
-    if (fp == NULL) {
-        printf("Error: Invalid file %s", file);
-        exit(1);
-    }
-
-    fseek(fp,0L,SEEK_END);
-    int fsize = ftell(fp);
-    fseek(fp,0L,SEEK_SET);
-
-    fread(&state->mem[pos],1,fsize, fp);
-
-    fclose(fp);
-}
-
-void inputHandler(CPUState* state) {
-    SDL_Event e;
-    while (SDL_PollEvent(&e)) {
-        if (e.type == SDL_KEYDOWN) {
-            switch (e.key.keysym.sym) {
-                case SDLK_c: state->ports.read1 |= 1; break;        // start/credit
-                case SDLK_u: state->ports.read1 |= 1 << 1; break;   // 2P start
-                case SDLK_e: state->ports.read1 |= 1 << 2; break;   // 1P start
-                case SDLK_w: state->ports.read1 |= 1 << 4; break;   // 1P shoot
-                case SDLK_a: state->ports.read1 |= 1 << 5; break;   // 1P L
-                case SDLK_d: state->ports.read1 |= 1 << 6; break;   // 1P R
-                case SDLK_i: state->ports.read2 |= 1 << 4; break;   // P2 shoot
-                case SDLK_j: state->ports.read2 |= 1 << 5; break;   // P2 L
-                case SDLK_l: state->ports.read2 |= 1 << 6; break;   // P2 R
-            }
-        } else if (e.type == SDL_KEYUP) {
-            switch (e.key.keysym.sym) {
-                case SDLK_c: state->ports.read1 &= ~1; break;        // start/credit
-                case SDLK_u: state->ports.read1 &= ~(1 << 1); break;   // 2P start
-                case SDLK_e: state->ports.read1 &= ~(1 << 2); break;   // 1P start
-                case SDLK_w: state->ports.read1 &= ~(1 << 4); break;   // 1P shoot
-                case SDLK_a: state->ports.read1 &= ~(1 << 5); break;   // 1P L
-                case SDLK_d: state->ports.read1 &= ~(1 << 6); break;   // 1P R
-                case SDLK_i: state->ports.read2 &= ~(1 << 4); break;   // P2 shoot
-                case SDLK_j: state->ports.read2 &= ~(1 << 5); break;   // P2 L
-                case SDLK_l: state->ports.read2 &= ~(1 << 6); break;   // P2 R 
-            }
-        } else if (e.type == SDL_QUIT) {
-            exit(0);
-        }
-    }
-}
-
-void initSDL() {
-    if(SDL_Init(SDL_INIT_VIDEO) < 0) {
-        printf("%s\n", SDL_GetError());
-        exit(1);
-    }
-
-    window = SDL_CreateWindow("Space Invaders", SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        SCREEN_WIDTH,
-        SCREEN_HEIGHT,
-        SDL_WINDOW_SHOWN);
-
-    if (window == NULL) {
-        printf("SDL Error: %s\n", SDL_GetError());
-        exit(1);
-    }
-    winsurface = SDL_GetWindowSurface(window);
-    surface = SDL_CreateRGBSurface(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, 0, 0,0,0);
-}
-
-int main(int argc, char** argv) {
-    int done = 0;
-    CPUState* CPU = initializeCPU();
-    initSDL();
-    
-    /*
-    loadFile(CPU, "./rom/invaders.h", 0x0000);
-    loadFile(CPU, "./rom/invaders.g", 0x0800);
-    loadFile(CPU, "./rom/invaders.f", 0x1000);
-    loadFile(CPU, "./rom/invaders.e", 0x1800); 
-    */
-
-    // for testing 
-    loadFile(CPU, "./rom/cpudiag.bin", 0x0100);
-    CPU->pc = 0x100;        // testing starts at 0x100
-    CPU->mem[368] = 0x7;    // fixing bug in asm
-    CPU->mem[0x59c] = 0xc3; // JMP to skip over DAA/ac test
-    CPU->mem[0x59d] = 0xc2;
-    CPU->mem[0x59e] = 0x05;
-
-    uint32_t now = SDL_GetTicks(); // in ms
-
-    while (!done) {
-        if (SDL_GetTicks() - now >= (1000.0/60.0)) {
-            
-            for (int i = 0; i < CYCLES_TICK/2;i++) {
-                
-                unsigned char* opcode = &CPU->mem[CPU->pc];
-                if (*opcode == 0xdb) { // IN D8
-                    uint8_t port = opcode[1];
-                    CPU->a = machineIN(CPU,port);
-                    CPU->pc+=2; 
-                } else if (*opcode == 0xd3) { // OUT D8
-                    uint8_t port = opcode[1];
-                    machineOUT(CPU,port);
-                    CPU->pc+=2;
-                } else {
-                    EmulateCPU(CPU);
-                }
-
-            }
-
-
-            now = SDL_GetTicks();
-        }
-
-
-    }
-        
-
-
-    return 0;
-}
\ No newline at end of file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <SDL2/SDL.h>
+#include "cpu.h"
+#include "machine.h"
+#include "disassembler.h"
+#include "triplebuffer.h"
+#include "emuloop.h"
+#include "sound.h"
+#include "video.h"
+#include "control.h"
+#include "metrics.h"
+#include "coverage.h"
+#include "cpm.h"
+#include "recorder.h"
+#include "gdbstub.h"
+#include "checkpoint.h"
+#include "screen.h"
+
+SDL_Window* window;
+SDL_Renderer* renderer;
+SDL_Texture* texture;
+Screen screen;
+
+// keys set and clear port bits for the emulation thread, returns 0 on quit
+int inputHandler(EmuLoop* loop) {
+    SDL_Event e;
+    while (SDL_PollEvent(&e)) {
+        if (e.type == SDL_KEYDOWN) {
+            switch (e.key.keysym.sym) {
+                case SDLK_c: atomic_fetch_or(&loop->input1, 1); break;        // start/credit
+                case SDLK_u: atomic_fetch_or(&loop->input1, 1 << 1); break;   // 2P start
+                case SDLK_e: atomic_fetch_or(&loop->input1, 1 << 2); break;   // 1P start
+                case SDLK_w: atomic_fetch_or(&loop->input1, 1 << 4); break;   // 1P shoot
+                case SDLK_a: atomic_fetch_or(&loop->input1, 1 << 5); break;   // 1P L
+                case SDLK_d: atomic_fetch_or(&loop->input1, 1 << 6); break;   // 1P R
+                case SDLK_i: atomic_fetch_or(&loop->input2, 1 << 4); break;   // P2 shoot
+                case SDLK_j: atomic_fetch_or(&loop->input2, 1 << 5); break;   // P2 L
+                case SDLK_l: atomic_fetch_or(&loop->input2, 1 << 6); break;   // P2 R
+                case SDLK_TAB: atomic_fetch_xor(&loop->turbo, 1); break;      // turbo
+            }
+        } else if (e.type == SDL_KEYUP) {
+            switch (e.key.keysym.sym) {
+                case SDLK_c: atomic_fetch_and(&loop->input1, ~1); break;        // start/credit
+                case SDLK_u: atomic_fetch_and(&loop->input1, ~(1 << 1)); break;   // 2P start
+                case SDLK_e: atomic_fetch_and(&loop->input1, ~(1 << 2)); break;   // 1P start
+                case SDLK_w: atomic_fetch_and(&loop->input1, ~(1 << 4)); break;   // 1P shoot
+                case SDLK_a: atomic_fetch_and(&loop->input1, ~(1 << 5)); break;   // 1P L
+                case SDLK_d: atomic_fetch_and(&loop->input1, ~(1 << 6)); break;   // 1P R
+                case SDLK_i: atomic_fetch_and(&loop->input2, ~(1 << 4)); break;   // P2 shoot
+                case SDLK_j: atomic_fetch_and(&loop->input2, ~(1 << 5)); break;   // P2 L
+                case SDLK_l: atomic_fetch_and(&loop->input2, ~(1 << 6)); break;   // P2 R
+            }
+        } else if (e.type == SDL_QUIT) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// runs on SDL's audio thread, only ever reads the ring
+void audioCallback(void* userdata, Uint8* stream, int len) {
+    Sound* snd = userdata;
+    readSound(&snd->ring, (int16_t*) stream, len / 2);
+}
+
+void initAudio(Sound* snd) {
+    SDL_AudioSpec want, have;
+    memset(&want, 0, sizeof(want));
+    want.freq = SOUND_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = 512;
+    want.callback = audioCallback;
+    want.userdata = snd;
+    SDL_AudioDeviceID dev = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if (dev == 0) {
+        printf("SDL Error: %s\n", SDL_GetError());
+        return;
+    }
+    snd->queue = 1;
+    SDL_PauseAudioDevice(dev, 0);
+}
+
+void initSDL(int scale, int overlay) {
+    if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
+        printf("%s\n", SDL_GetError());
+        exit(1);
+    }
+
+    initializeScreen(&screen, scale, overlay);
+    window = SDL_CreateWindow("Space Invaders", SDL_WINDOWPOS_UNDEFINED,
+        SDL_WINDOWPOS_UNDEFINED,
+        screen.width,
+        screen.height,
+        SDL_WINDOW_SHOWN);
+
+    if (window == NULL) {
+        printf("SDL Error: %s\n", SDL_GetError());
+        exit(1);
+    }
+    // the emulation thread paces the frames, so no vsync here
+    renderer = SDL_CreateRenderer(window, -1, 0);
+    texture = renderer ? SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+        screen.width, screen.height) : NULL;
+    if (texture == NULL) {
+        printf("SDL Error: %s\n", SDL_GetError());
+        exit(1);
+    }
+}
+
+// renders straight into the locked texture, render and present times go to metrics when set
+void drawFrame(uint8_t* vram, Metrics* metrics) {
+    int64_t begin = metrics ? metricsNow() : 0;
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, NULL, &pixels, &pitch) < 0)
+        return;
+    renderScreen(&screen, vram, pixels, pitch);
+    SDL_UnlockTexture(texture);
+    int64_t rendered = metrics ? metricsNow() : 0;
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    SDL_RenderPresent(renderer);
+    if (metrics) {
+        recordMetric(metrics, HIST_RENDER, rendered - begin);
+        recordMetric(metrics, HIST_PRESENT, metricsNow() - rendered);
+    }
+}
+
+// cpudiag.bin under the CP/M trap layer, exits with 0 if it passed
+void runDiag() {
+    CPM cpm;
+    if (!initializeCPM(&cpm, "./rom/cpudiag.bin")) {
+        printf("Error: can't read ./rom/cpudiag.bin\n");
+        exit(1);
+    }
+    cpm.echo = 1;
+    int status = runCPM(&cpm, 0, 10000);
+    printf("\n");
+    exit(status != CPM_BOOTED || strstr(cpm.output, "ERROR") != NULL);
+}
+
+void saveCoverage(Coverage* coverage, CPUState* CPU, char* prefix) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.lst", prefix);
+    FILE* out = fopen(path, "w");
+    if (out) {
+        writeCoverageListing(coverage, CPU->mem, out);
+        fclose(out);
+    }
+    snprintf(path, sizeof(path), "%s.heat", prefix);
+    if (out == NULL || !writeHeatmap(coverage, path))
+        printf("Error: can't write coverage to %s\n", path);
+}
+
+/*
+    usage: cpu [-headless [frames]] [-wav file] [-samples dir] [-turbo] [-skip n]
+               [-y4m file] [-raw file] [-delta file] [-shm name]
+               [-metrics file] [-prometheus port] [-coverage prefix]
+               [-crash prefix] [-load file] [-gdb port] [-diag]
+               [-checkpoint file] [-every n] [-restore file frame]
+               [-scale n] [-mono] [-runahead n]
+    Emulation runs on its own thread and hands frames to this one through
+    a triple buffer, so a slow present never holds up the CPU. Headless
+    runs the same loop flat out on the main thread, -wav saves its audio.
+    Tab or -turbo runs unthrottled, showing every nth frame with -skip or
+    else one frame per display refresh. -y4m, -raw and -delta record
+    every frame to a file, or to stdout when given "-". -shm hands the
+    machine to an agent in another process through a shared memory
+    control block until it sends CONTROL_QUIT. -metrics rewrites timing
+    histograms and counters to file every second, as JSON if it ends in
+    .json, and -prometheus serves them on a local port. -coverage runs
+    the instrumented step and writes prefix.lst and prefix.heat on exit.
+    Otherwise the flight recorder keeps the last instructions, written to
+    crash.trace and crash.state, or -crash prefix, on a fault, a fatal
+    signal or SIGUSR1. -load resumes from such a state. -gdb listens for
+    GDB's remote protocol on a local port, target remote :port with
+    set architecture z80.
+    -checkpoint appends a save state every second, or every n frames with
+    -every, to a log file without blocking the loop on the disk.
+    -restore starts from the log's latest checkpoint at or before frame.
+    The window is the upright screen scaled 3x, or 1 to 6 times with
+    -scale, under the cabinet's red and green gel strips unless -mono.
+    -runahead shows the screen n frames ahead of the machine to hide the
+    game's own input lag. It's off under -gdb, where a breakpoint could
+    land in a speculative frame.
+*/
+int main(int argc, char** argv) {
+    int headless = 0;
+    uint64_t frames = 0;
+    char* wav = NULL;
+    char* record = NULL;
+    char* shm = NULL;
+    char* metricsPath = NULL;
+    int prometheus = 0;
+    char* coveragePrefix = NULL;
+    char* crashPrefix = "crash";
+    char* load = NULL;
+    int gdbPort = 0;
+    char* checkpointPath = NULL;
+    int checkpointEvery = FRAME_HZ;
+    char* restore = NULL;
+    uint64_t restoreFrame = 0;
+    int scale = 3, overlay = 1;
+    int format = VIDEO_Y4M;
+    char* samples = "./rom/samples";
+    int turbo = 0, skip = 0;
+    int runAhead = 0;
+    CPUState* CPU = initializeCPU();
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-diag") == 0) {
+            runDiag();
+        } else if (strcmp(argv[i], "-headless") == 0) {
+            headless = 1;
+        } else if (strcmp(argv[i], "-wav") == 0 && i + 1 < argc) {
+            wav = argv[++i];
+        } else if (strcmp(argv[i], "-samples") == 0 && i + 1 < argc) {
+            samples = argv[++i];
+        } else if (strcmp(argv[i], "-y4m") == 0 && i + 1 < argc) {
+            record = argv[++i];
+            format = VIDEO_Y4M;
+        } else if (strcmp(argv[i], "-raw") == 0 && i + 1 < argc) {
+            record = argv[++i];
+            format = VIDEO_RAW;
+        } else if (strcmp(argv[i], "-delta") == 0 && i + 1 < argc) {
+            record = argv[++i];
+            format = VIDEO_DELTA;
+        } else if (strcmp(argv[i], "-shm") == 0 && i + 1 < argc) {
+            shm = argv[++i];
+        } else if (strcmp(argv[i], "-metrics") == 0 && i + 1 < argc) {
+            metricsPath = argv[++i];
+        } else if (strcmp(argv[i], "-prometheus") == 0 && i + 1 < argc) {
+            prometheus = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-coverage") == 0 && i + 1 < argc) {
+            coveragePrefix = argv[++i];
+        } else if (strcmp(argv[i], "-crash") == 0 && i + 1 < argc) {
+            crashPrefix = argv[++i];
+        } else if (strcmp(argv[i], "-load") == 0 && i + 1 < argc) {
+            load = argv[++i];
+        } else if (strcmp(argv[i], "-gdb") == 0 && i + 1 < argc) {
+            gdbPort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-checkpoint") == 0 && i + 1 < argc) {
+            checkpointPath = argv[++i];
+        } else if (strcmp(argv[i], "-every") == 0 && i + 1 < argc) {
+            checkpointEvery = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-restore") == 0 && i + 2 < argc) {
+            restore = argv[++i];
+            restoreFrame = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-scale") == 0 && i + 1 < argc) {
+            scale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-mono") == 0) {
+            overlay = 0;
+        } else if (strcmp(argv[i], "-turbo") == 0) {
+            turbo = 1;
+        } else if (strcmp(argv[i], "-skip") == 0 && i + 1 < argc) {
+            skip = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-runahead") == 0 && i + 1 < argc) {
+            runAhead = atoi(argv[++i]);
+        } else {
+            frames = strtoull(argv[i], NULL, 10);
+        }
+    }
+
+    if (!loadInvaders(CPU)) {
+        printf("Error: can't read the ROM from ./rom\n");
+        exit(1);
+    }
+    if (load && !loadStateFile(CPU, load)) {
+        printf("Error: can't load state from %s\n", load);
+        exit(1);
+    }
+    if (restore) {
+        CheckpointLog* log = openCheckpointLog(restore);
+        int64_t found = log ? findCheckpoint(log, 0, restoreFrame) : -1;
+        if (found < 0 || !readCheckpoint(log, found, CPU)) {
+            printf("Error: no checkpoint at or before frame %llu in %s\n", (unsigned long long) restoreFrame, restore);
+            exit(1);
+        }
+        closeCheckpointLog(log);
+    }
+    if (shm) {
+        Control* ctl = createControl(shm);
+        if (ctl == NULL) {
+            printf("Error: can't create shared memory %s\n", shm);
+            exit(1);
+        }
+        serveControl(ctl, CPU, stepMachine);
+        closeControl(ctl);
+        return 0;
+    }
+
+    Metrics* metrics = NULL;
+    if (metricsPath || prometheus) {
+        metrics = initializeMetrics();
+        if (!startMetrics(metrics, metricsPath, 1000, prometheus)) {
+            printf("Error: can't listen on port %d\n", prometheus);
+            exit(1);
+        }
+    }
+
+    Coverage* coverage = NULL;
+    StepFn step = stepRecorded;
+    if (coveragePrefix) {
+        coverage = calloc(1, sizeof(Coverage));
+        startCoverage(coverage);
+        step = stepCoverage;
+    } else {
+        startRecorder(malloc(sizeof(Recorder)), crashPrefix);
+    }
+    if (gdbPort) {
+        if (startDebugger(gdbPort, step) == NULL) {
+            printf("Error: can't listen on port %d\n", gdbPort);
+            exit(1);
+        }
+        step = stepDebug;
+        runAhead = 0;
+    }
+
+    Sound* snd = initializeSound(samples);
+    EmuLoop loop;
+    VideoWriter* video = NULL;
+    if (record && (video = openVideo(record, format)) == NULL) {
+        printf("Error: can't open %s\n", record);
+        exit(1);
+    }
+    Checkpoints* checkpoints = NULL;
+    if (checkpointPath && (checkpoints = createCheckpoints(checkpointPath, 8)) == NULL) {
+        printf("Error: can't create %s\n", checkpointPath);
+        exit(1);
+    }
+    if (checkpointEvery < 1)
+        checkpointEvery = 1;
+
+    if (headless) {
+        initializeEmuLoop(&loop, CPU, NULL);
+        loop.paced = 0;
+        loop.maxFrames = frames ? frames : 60 * 60;
+        if (wav && openWav(snd, wav))
+            loop.sound = snd;
+        loop.video = video;
+        loop.metrics = metrics;
+        loop.checkpoints = checkpoints;
+        loop.checkpointEvery = checkpointEvery;
+        loop.runAhead = runAhead;
+        loop.step = step;
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        runEmuLoop(&loop);
+        if (video)
+            closeVideo(video);
+        if (checkpoints && !closeCheckpoints(checkpoints))
+            printf("Error: can't write checkpoints to %s\n", checkpointPath);
+        if (metrics)
+            stopMetrics(metrics);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (coverage)
+            saveCoverage(coverage, CPU, coveragePrefix);
+        double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        // stdout may be carrying the video
+        fprintf(record && strcmp(record, "-") == 0 ? stderr : stdout, "%llu frames in %.3fs, %.1fx realtime\n",
+            atomic_load(&loop.frame), secs, atomic_load(&loop.frame) / (secs * FRAME_HZ));
+        freeSound(snd);
+        // HLT is a clean stop, an unimplemented opcode isn't
+        return CPU->stopped == CPU_FAULTED;
+    }
+
+    initSDL(scale, overlay);
+    initAudio(snd);
+    TripleBuffer* frameBuffer = malloc(sizeof(TripleBuffer));
+    initializeTripleBuffer(frameBuffer);
+    initializeEmuLoop(&loop, CPU, frameBuffer);
+    loop.maxFrames = frames;
+    loop.sound = snd;
+    loop.presentEvery = skip;
+    loop.video = video;
+    loop.metrics = metrics;
+    loop.checkpoints = checkpoints;
+    loop.checkpointEvery = checkpointEvery;
+    loop.runAhead = runAhead;
+    loop.step = step;
+    atomic_store(&loop.turbo, turbo);
+
+    pthread_t emulation;
+    pthread_create(&emulation, NULL, runEmuLoop, &loop);
+
+    uint32_t titled = 0;
+    while (atomic_load(&loop.running)) {
+        if (!inputHandler(&loop))
+            atomic_store(&loop.running, 0);
+
+        int fresh;
+        uint8_t* vram = latestFrame(frameBuffer, &fresh);
+        if (fresh)
+            drawFrame(vram, metrics);
+        else
+            SDL_Delay(1);
+
+        // the title shows the speed multiplier while in turbo
+        if (SDL_GetTicks() - titled >= 500) {
+            char title[64];
+            if (atomic_load(&loop.turbo))
+                snprintf(title, sizeof(title), "Space Invaders - turbo %.1fx", atomic_load(&loop.speed) / 100.0);
+            else
+                snprintf(title, sizeof(title), "Space Invaders");
+            SDL_SetWindowTitle(window, title);
+            titled = SDL_GetTicks();
+        }
+    }
+
+    pthread_join(emulation, NULL);
+    if (video)
+        closeVideo(video);
+    if (checkpoints && !closeCheckpoints(checkpoints))
+        printf("Error: can't write checkpoints to %s\n", checkpointPath);
+    if (metrics)
+        stopMetrics(metrics);
+    if (coverage)
+        saveCoverage(coverage, CPU, coveragePrefix);
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return CPU->stopped == CPU_FAULTED;
+}
@@ -0,0 +1,31 @@
+#include <stdint.h>
+#include "cpu.h"
+#include "memmap.h"
+
+// ROM writes land in 0x4000-0x5fff of mem, which the mirrors hide from reads
+#define ROM_SINK 0x4000
+
+// the address decoder ignores A14 and A15 for RAM
+#define RAM_MIRRORS \
+    [0x20 ... 0x3f] = 0, \
+    [0x40 ... 0x5f] = -0x2000, \
+    [0x60 ... 0x7f] = -0x4000, \
+    [0x80 ... 0x9f] = -0x6000, \
+    [0xa0 ... 0xbf] = -0x8000, \
+    [0xc0 ... 0xdf] = -0xa000, \
+    [0xe0 ... 0xff] = -0xc000
+
+const MemoryMap invadersMap = {
+    .read = { [0x00 ... 0x1f] = 0, RAM_MIRRORS },
+    .write = { [0x00 ... 0x1f] = ROM_SINK, RAM_MIRRORS },
+};
+
+const MemoryMap flatMap = { 0 };
+
+int hasHandlerPages(const MemoryMap* map) {
+    for (int i = 0; i < PAGE_COUNT; i++) {
+        if (map->read[i] == PAGE_HANDLER || map->write[i] == PAGE_HANDLER)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef __memmap_h__
+#define __memmap_h__
+
+#include <stdint.h>
+#include "cpu.h"
+
+#define PAGE_SHIFT 8
+#define PAGE_COUNT (0x10000 >> PAGE_SHIFT)
+
+// page entry that sends accesses to the map's handlers instead of memory
+#define PAGE_HANDLER INT32_MIN
+
+/*
+    Where each 256 byte page of the address space lives. An entry is what
+    to add to an address to find its byte in the instance's mem, so plain
+    pages cost one add and no branch on the data, and one table serves
+    every instance. Mirrors point back at the page they repeat, and ROM
+    points its writes at a scratch page nothing reads. PAGE_HANDLER pages
+    go through the handlers, the single place to hang I/O mapped devices,
+    VRAM dirty tracking or watchpoints on. Instruction fetch skips the map
+    and reads mem at pc, so code has to sit at its own address.
+*/
+typedef struct MemoryMap {
+    int32_t read[PAGE_COUNT];
+    int32_t write[PAGE_COUNT];
+    uint8_t (*readHandler)(CPUState* state, uint16_t addr);
+    void (*writeHandler)(CPUState* state, uint16_t addr, uint8_t val);
+} MemoryMap;
+
+// ROM at 0x0000-0x1fff, RAM at 0x2000-0x3fff and mirrored up to 0xffff
+extern const MemoryMap invadersMap;
+
+// all 64KB plain RAM, for CP/M programs
+extern const MemoryMap flatMap;
+
+static inline uint8_t readByte(CPUState* state, uint16_t addr) {
+    int32_t offset = state->map->read[addr >> PAGE_SHIFT];
+    if (__builtin_expect(offset == PAGE_HANDLER, 0))
+        return state->map->readHandler(state, addr);
+    return state->mem[addr + offset];
+}
+
+static inline void writeByte(CPUState* state, uint16_t addr, uint8_t val) {
+    int32_t offset = state->map->write[addr >> PAGE_SHIFT];
+    if (__builtin_expect(offset == PAGE_HANDLER, 0))
+        state->map->writeHandler(state, addr, val);
+    else
+        state->mem[addr + offset] = val;
+}
+
+// little endian word, each byte mapped on its own so it can wrap or straddle pages
+static inline uint16_t readWord(CPUState* state, uint16_t addr) {
+    return readByte(state, addr + 1) << 8 | readByte(state, addr);
+}
+
+static inline void writeWord(CPUState* state, uint16_t addr, uint16_t val) {
+    writeByte(state, addr, val & 0xff);
+    writeByte(state, addr + 1, val >> 8);
+}
+
+/*
+    The address of the byte addr names, so mirrors fold onto the RAM they
+    repeat. It follows the read side of the map, which leaves ROM as it
+    is where its writes would go to the scratch page. Handler pages stay
+    as they are.
+*/
+static inline uint16_t homeAddress(CPUState* state, uint16_t addr) {
+    int32_t offset = state->map->read[addr >> PAGE_SHIFT];
+    return offset == PAGE_HANDLER ? addr : addr + offset;
+}
+
+int     hasHandlerPages(const MemoryMap* map);
+
+#endif
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "metrics.h"
+
+static const char* histNames[HIST_COUNT] = {
+    "frame_ns", "emulate_ns", "render_ns", "present_ns", "instructions_per_frame", "cycles_per_frame"
+};
+
+static const char* counterNames[COUNT_COUNT] = {
+    "frames", "late_frames", "dropped_frames", "instructions", "cycles", "interrupts"
+};
+
+static const double percentiles[] = { 50, 90, 99, 99.9 };
+#define PERCENTILES (sizeof(percentiles) / sizeof(percentiles[0]))
+
+int64_t metricsNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+Metrics* initializeMetrics() {
+    Metrics* m = calloc(1, sizeof(Metrics));
+    m->listener = -1;
+    m->startNs = metricsNow();
+    return m;
+}
+
+static inline int bucketOf(uint64_t v) {
+    if (v < HIST_SUB)
+        return v;
+    int e = 63 - __builtin_clzll(v);
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + ((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+// largest value that lands in bucket i
+static uint64_t bucketTop(int i) {
+    if (i < HIST_SUB)
+        return i;
+    int shift = i / HIST_SUB - 1;
+    return ((uint64_t) (HIST_SUB + i % HIST_SUB) << shift) + ((uint64_t) 1 << shift) - 1;
+}
+
+static inline void bump(atomic_ullong* x, uint64_t n) {
+    atomic_store_explicit(x, atomic_load_explicit(x, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+void recordMetric(Metrics* m, int hist, uint64_t value) {
+    Histogram* h = &m->hist[hist];
+    bump(&h->counts[bucketOf(value)], 1);
+    bump(&h->count, 1);
+    bump(&h->sum, value);
+    if (value > atomic_load_explicit(&h->max, memory_order_relaxed))
+        atomic_store_explicit(&h->max, value, memory_order_relaxed);
+}
+
+uint64_t metricPercentile(Histogram* h, double percentile) {
+    uint64_t count = atomic_load_explicit(&h->count, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    if (count == 0)
+        return 0;
+    uint64_t want = (uint64_t) (count * percentile / 100.0 + 0.5);
+    if (want < 1)
+        want = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        if (seen >= want)
+            return bucketTop(i) < max ? bucketTop(i) : max;
+    }
+    return max;
+}
+
+void writeMetrics(Metrics* m, FILE* out, int format) {
+    double secs = (metricsNow() - m->startNs) / 1e9;
+    uint64_t counters[COUNT_COUNT];
+    for (int i = 0; i < COUNT_COUNT; i++)
+        counters[i] = atomic_load_explicit(&m->counters[i], memory_order_relaxed);
+    double mhz = secs > 0 ? counters[COUNT_CYCLES] / secs / 1e6 : 0;
+
+    if (format == METRICS_JSON) {
+        fprintf(out, "{\n  \"uptime_s\": %.3f,\n  \"emulated_mhz\": %.3f,\n", secs, mhz);
+        for (int i = 0; i < COUNT_COUNT; i++)
+            fprintf(out, "  \"%s\": %llu,\n", counterNames[i], (unsigned long long) counters[i]);
+        fprintf(out, "  \"histograms\": {\n");
+        for (int i = 0; i < HIST_COUNT; i++) {
+            Histogram* h = &m->hist[i];
+            uint64_t count = atomic_load(&h->count);
+            fprintf(out, "    \"%s\": { \"count\": %llu, \"mean\": %.1f, \"max\": %llu",
+                histNames[i], (unsigned long long) count,
+                count ? (double) atomic_load(&h->sum) / count : 0.0, (unsigned long long) atomic_load(&h->max));
+            for (size_t p = 0; p < PERCENTILES; p++)
+                fprintf(out, ", \"p%g\": %llu", percentiles[p], (unsigned long long) metricPercentile(h, percentiles[p]));
+            fprintf(out, " }%s\n", i + 1 < HIST_COUNT ? "," : "");
+        }
+        fprintf(out, "  }\n}\n");
+    } else if (format == METRICS_PROMETHEUS) {
+        fprintf(out, "# TYPE invaders_emulated_mhz gauge\ninvaders_emulated_mhz %.3f\n", mhz);
+        for (int i = 0; i < COUNT_COUNT; i++)
+            fprintf(out, "# TYPE invaders_%s_total counter\ninvaders_%s_total %llu\n",
+                counterNames[i], counterNames[i], (unsigned long long) counters[i]);
+        for (int i = 0; i < HIST_COUNT; i++) {
+            Histogram* h = &m->hist[i];
+            fprintf(out, "# TYPE invaders_%s summary\n", histNames[i]);
+            for (size_t p = 0; p < PERCENTILES; p++)
+                fprintf(out, "invaders_%s{quantile=\"%g\"} %llu\n", histNames[i], percentiles[p] / 100,
+                    (unsigned long long) metricPercentile(h, percentiles[p]));
+            fprintf(out, "invaders_%s_sum %llu\ninvaders_%s_count %llu\n",
+                histNames[i], (unsigned long long) atomic_load(&h->sum),
+                histNames[i], (unsigned long long) atomic_load(&h->count));
+        }
+    } else {
+        fprintf(out, "uptime %.3fs, %.3f emulated MHz\n", secs, mhz);
+        for (int i = 0; i < COUNT_COUNT; i++)
+            fprintf(out, "%-24s %llu\n", counterNames[i], (unsigned long long) counters[i]);
+        for (int i = 0; i < HIST_COUNT; i++) {
+            Histogram* h = &m->hist[i];
+            uint64_t count = atomic_load(&h->count);
+            if (count == 0)
+                continue;
+            fprintf(out, "%-24s n=%llu mean=%.0f", histNames[i], (unsigned long long) count,
+                (double) atomic_load(&h->sum) / count);
+            for (size_t p = 0; p < PERCENTILES; p++)
+                fprintf(out, " p%g=%llu", percentiles[p], (unsigned long long) metricPercentile(h, percentiles[p]));
+            fprintf(out, " max=%llu\n", (unsigned long long) atomic_load(&h->max));
+        }
+    }
+}
+
+// written beside the target and renamed over it, so readers never see half a dump
+static void dumpMetrics(Metrics* m) {
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", m->path);
+    FILE* out = fopen(tmp, "w");
+    if (out == NULL)
+        return;
+    size_t len = strlen(m->path);
+    int json = len > 5 && strcmp(m->path + len - 5, ".json") == 0;
+    writeMetrics(m, out, json ? METRICS_JSON : METRICS_TEXT);
+    fclose(out);
+    rename(tmp, m->path);
+}
+
+// any request gets the metrics, scrapers only ever ask for /metrics
+static void serveScrape(Metrics* m) {
+    int fd = accept(m->listener, NULL, NULL);
+    if (fd < 0)
+        return;
+    char request[1024];
+    struct pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, 100) > 0)
+        read(fd, request, sizeof(request));
+
+    char* body = NULL;
+    size_t size = 0;
+    FILE* out = open_memstream(&body, &size);
+    writeMetrics(m, out, METRICS_PROMETHEUS);
+    fclose(out);
+
+    char header[128];
+    int n = snprintf(header, sizeof(header),
+        "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", size);
+    write(fd, header, n);
+    write(fd, body, size);
+    free(body);
+    close(fd);
+}
+
+static void* reporterThread(void* arg) {
+    Metrics* m = arg;
+    int64_t next = metricsNow() + m->intervalMs * 1000000LL;
+    while (atomic_load(&m->running)) {
+        int64_t wait = (next - metricsNow()) / 1000000;
+        // wake at least every 100ms to notice stopMetrics
+        if (wait > 100)
+            wait = 100;
+        if (wait < 0)
+            wait = 0;
+
+        struct pollfd p = { m->listener, POLLIN, 0 };
+        if (poll(&p, m->listener >= 0, wait) > 0)
+            serveScrape(m);
+
+        if (m->path && metricsNow() >= next) {
+            dumpMetrics(m);
+            next += m->intervalMs * 1000000LL;
+        }
+    }
+    return NULL;
+}
+
+int startMetrics(Metrics* m, const char* path, int intervalMs, int port) {
+    m->path = path;
+    m->intervalMs = intervalMs > 0 ? intervalMs : 1000;
+    m->port = port;
+    if (port > 0) {
+        m->listener = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(m->listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in addr = { 0 };
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(m->listener, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(m->listener, 8) < 0) {
+            close(m->listener);
+            m->listener = -1;
+            return 0;
+        }
+    }
+    atomic_store(&m->running, 1);
+    pthread_create(&m->thread, NULL, reporterThread, m);
+    return 1;
+}
+
+void stopMetrics(Metrics* m) {
+    if (atomic_exchange(&m->running, 0))
+        pthread_join(m->thread, NULL);
+    if (m->path)
+        dumpMetrics(m);
+    if (m->listener >= 0)
+        close(m->listener);
+    m->listener = -1;
+}
@@ -0,0 +1,85 @@
+#ifndef __metrics_h__
+#define __metrics_h__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+// log-linear buckets, 32 per power of two, so any value is within about 3% of its bucket
+#define HIST_SUB_BITS 5
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+enum {
+    HIST_FRAME,         // host ns from one frame start to the next
+    HIST_EMULATE,       // host ns running the CPU for a frame
+    HIST_RENDER,        // host ns converting VRAM to pixels
+    HIST_PRESENT,       // host ns handing the picture to the display
+    HIST_INSTRUCTIONS,  // per frame
+    HIST_CYCLES,        // per frame
+    HIST_COUNT
+};
+
+enum {
+    COUNT_FRAMES,
+    COUNT_LATE,         // paced frames that started over a frame behind schedule
+    COUNT_DROPPED,      // frames the display never got
+    COUNT_INSTRUCTIONS,
+    COUNT_CYCLES,
+    COUNT_INTERRUPTS,
+    COUNT_COUNT
+};
+
+/*
+    Each histogram and counter has a single writing thread, so updates
+    are a relaxed load and store with no locked instructions. The
+    reporting thread may see a value a few updates stale.
+*/
+enum {
+    METRICS_TEXT,
+    METRICS_JSON,
+    METRICS_PROMETHEUS
+};
+
+typedef struct Histogram {
+    atomic_ullong counts[HIST_BUCKETS];
+    atomic_ullong count;
+    atomic_ullong sum;
+    atomic_ullong max;
+} Histogram;
+
+typedef struct Metrics {
+    Histogram hist[HIST_COUNT];
+    atomic_ullong counters[COUNT_COUNT];
+
+    // reporter
+    const char* path;       // rewritten every interval, JSON if it ends in .json
+    int intervalMs;
+    int port;               // Prometheus text on 127.0.0.1, 0 for none
+    int listener;
+    atomic_int running;
+    pthread_t thread;
+    int64_t startNs;
+} Metrics;
+
+Metrics*    initializeMetrics();
+
+static inline void countMetric(Metrics* m, int counter, uint64_t n) {
+    atomic_ullong* c = &m->counters[counter];
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+void        recordMetric(Metrics* m, int hist, uint64_t value);
+uint64_t    metricPercentile(Histogram* h, double percentile);
+
+void        writeMetrics(Metrics* m, FILE* out, int format);
+
+// dumps to path every intervalMs and serves port if set, returns 0 if the port can't be bound
+int         startMetrics(Metrics* m, const char* path, int intervalMs, int port);
+// writes a last dump and stops the reporter
+void        stopMetrics(Metrics* m);
+
+int64_t     metricsNow();
+
+#endif
@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "cpu.h"
+#include "machine.h"
+#include "netplay.h"
+
+#define NET_MAGIC 0x5349    // "SI"
+#define MAX_INPUTS 32       // inputs resent per packet
+
+/*
+    packet, little endian:
+    magic u16, frame u32, count u8, count inputs ending at frame,
+    ack u32, checkFrame u32, check u32
+*/
+#define PACKET_SIZE (2 + 4 + 1 + MAX_INPUTS + 4 + 4 + 4)
+
+static void put32(uint8_t* p, uint32_t x) {
+    p[0] = x;
+    p[1] = x >> 8;
+    p[2] = x >> 16;
+    p[3] = x >> 24;
+}
+
+static uint32_t get32(uint8_t* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+// FNV-1a over RAM a word at a time
+uint32_t ramChecksum(CPUState* state) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    uint64_t* words = (uint64_t*) &state->mem[RAM_START];
+    for (int i = 0; i < RAM_SIZE / 8; i++)
+        hash = (hash ^ words[i]) * 0x100000001b3ull;
+    return hash ^ hash >> 32;
+}
+
+Netplay* initializeNetplay(int player, int localPort, const char* host, int remotePort) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+        return NULL;
+
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(localPort);
+    if (bind(sock, (struct sockaddr*) &local, sizeof(local)) < 0) {
+        close(sock);
+        return NULL;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+
+    Netplay* np = calloc(1, sizeof(Netplay));
+    np->player = player;
+    np->sock = sock;
+    np->remote.sin_family = AF_INET;
+    np->remote.sin_port = htons(remotePort);
+    if (inet_pton(AF_INET, host, &np->remote.sin_addr) != 1) {
+        close(sock);
+        free(np);
+        return NULL;
+    }
+    np->remoteFrame = -1;
+    np->remoteAck = -1;
+    np->rollbackFrom = -1;
+    np->peerCheckFrame = -1;
+    np->desyncFrame = -1;
+    return np;
+}
+
+void freeNetplay(Netplay* np) {
+    close(np->sock);
+    free(np);
+}
+
+int32_t netplayConfirmed(Netplay* np) {
+    int32_t ran = (int32_t) np->frame - 1;
+    return np->remoteFrame < ran ? np->remoteFrame : ran;
+}
+
+// inputs the remote doesn't have yet, plus the newest checksum both sides can agree on
+static void sendInputs(Netplay* np) {
+    if (np->frame == 0)
+        return;
+    int32_t last = np->frame - 1;
+    int32_t first = np->remoteAck + 1;
+    if (first < last - MAX_INPUTS + 1)
+        first = last - MAX_INPUTS + 1;
+    int count = last - first + 1;
+
+    uint8_t packet[PACKET_SIZE];
+    int n = 0;
+    packet[n++] = NET_MAGIC & 0xff;
+    packet[n++] = NET_MAGIC >> 8;
+    put32(&packet[n], last);
+    n += 4;
+    packet[n++] = count;
+    for (int32_t f = first; f <= last; f++)
+        packet[n++] = np->local[f % NET_HISTORY];
+    put32(&packet[n], np->remoteFrame);
+    n += 4;
+    int32_t final = netplayConfirmed(np);
+    put32(&packet[n], final);
+    n += 4;
+    put32(&packet[n], final >= 0 ? np->check[final % NET_HISTORY] : 0);
+    n += 4;
+
+    sendto(np->sock, packet, n, 0, (struct sockaddr*) &np->remote, sizeof(np->remote));
+}
+
+static void receiveInputs(Netplay* np) {
+    uint8_t packet[PACKET_SIZE];
+    ssize_t len;
+    while ((len = recv(np->sock, packet, sizeof(packet), 0)) > 0) {
+        if (len < 7 || (packet[0] | packet[1] << 8) != NET_MAGIC)
+            continue;
+        int32_t last = get32(&packet[2]);
+        int count = packet[6];
+        if (count > MAX_INPUTS || len != 7 + count + 12)
+            continue;
+
+        // inputs only count once every earlier one has arrived
+        for (int i = 0; i < count; i++) {
+            int32_t f = last - count + 1 + i;
+            if (f != np->remoteFrame + 1)
+                continue;
+            uint8_t input = packet[7 + i];
+            if ((uint32_t) f < np->frame && np->remoteInput[f % NET_HISTORY] != input
+                    && (np->rollbackFrom < 0 || f < np->rollbackFrom))
+                np->rollbackFrom = f;
+            np->remoteInput[f % NET_HISTORY] = input;
+            np->remoteFrame = f;
+        }
+
+        uint8_t* tail = &packet[7 + count];
+        int32_t ack = get32(tail);
+        if (ack > np->remoteAck)
+            np->remoteAck = ack;
+        int32_t checkFrame = get32(tail + 4);
+        if (checkFrame > np->peerCheckFrame) {
+            np->peerCheckFrame = checkFrame;
+            np->peerCheck = get32(tail + 8);
+        }
+    }
+}
+
+// player 0 drives port 1, player 1 port 2 and the 2P start button
+static void applyInputs(CPUState* state, uint8_t p1, uint8_t p2) {
+    state->ports.read1 = 0x08 | (p1 & (NET_FIRE | NET_LEFT | NET_RIGHT))
+        | ((p1 | p2) & NET_COIN)
+        | (p1 & NET_START ? 0x04 : 0)
+        | (p2 & NET_START ? 0x02 : 0);
+    state->ports.read2 = (state->ports.read2 & 0x8f) | (p2 & (NET_FIRE | NET_LEFT | NET_RIGHT));
+}
+
+static void runNetFrame(Netplay* np, CPUState* state, uint32_t f) {
+    int i = f % NET_HISTORY;
+    saveState(state, &np->saves[i]);
+    if ((int32_t) f > np->remoteFrame)
+        np->remoteInput[i] = np->remoteFrame >= 0 ? np->remoteInput[np->remoteFrame % NET_HISTORY] : 0;
+
+    if (np->player == 0)
+        applyInputs(state, np->local[i], np->remoteInput[i]);
+    else
+        applyInputs(state, np->remoteInput[i], np->local[i]);
+    runFrame(state);
+    np->check[i] = ramChecksum(state);
+}
+
+void netplayPoll(Netplay* np, CPUState* state) {
+    receiveInputs(np);
+
+    if (np->rollbackFrom >= 0) {
+        loadState(state, &np->saves[np->rollbackFrom % NET_HISTORY]);
+        for (uint32_t f = np->rollbackFrom; f < np->frame; f++) {
+            runNetFrame(np, state, f);
+            np->resimulated++;
+        }
+        np->rollbacks++;
+        np->rollbackFrom = -1;
+    }
+
+    int32_t f = np->peerCheckFrame;
+    if (np->desyncFrame < 0 && f >= 0 && f <= netplayConfirmed(np)
+            && f > (int32_t) np->frame - NET_HISTORY && np->check[f % NET_HISTORY] != np->peerCheck)
+        np->desyncFrame = f;
+
+    sendInputs(np);
+}
+
+int netplayFrame(Netplay* np, CPUState* state, uint8_t input) {
+    netplayPoll(np, state);
+    if ((int32_t) np->frame - np->remoteFrame - 1 > NET_MAX_AHEAD) {
+        np->stalls++;
+        return 0;
+    }
+
+    np->local[np->frame % NET_HISTORY] = input;
+    runNetFrame(np, state, np->frame);
+    np->frame++;
+    sendInputs(np);
+    return 1;
+}
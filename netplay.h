@@ -0,0 +1,72 @@
+#ifndef __netplay_h__
+#define __netplay_h__
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include "cpu.h"
+#include "machine.h"
+
+#define NET_HISTORY 64      // frames of inputs, saves and checksums kept
+#define NET_MAX_AHEAD 8     // frames run on predicted input before stalling
+
+// one player's inputs for a frame, controls use the port bit positions
+#define NET_COIN 0x01
+#define NET_START 0x02
+#define NET_FIRE 0x10
+#define NET_LEFT 0x20
+#define NET_RIGHT 0x40
+
+/*
+    Rollback netplay between two peers over UDP. Each peer runs frames on
+    its own input straight away and guesses the remote one by repeating
+    the last input it got. When the real input turns out different the
+    machine is loaded from the save at that frame and run forward again.
+    Both sides checksum RAM once a frame's inputs are final and compare
+    to catch desyncs.
+
+    Player 0 is P1 on port 1, player 1 is P2 on port 2. Both machines must
+    start from the same state.
+*/
+typedef struct Netplay {
+    int player;
+    int sock;
+    struct sockaddr_in remote;
+
+    uint32_t frame;             // next frame to run
+    int32_t remoteFrame;        // newest remote input received in order, -1 for none
+    int32_t remoteAck;          // newest local input the remote has
+    int32_t rollbackFrom;       // earliest frame run on a wrong guess, -1 for none
+
+    uint8_t local[NET_HISTORY];
+    uint8_t remoteInput[NET_HISTORY];   // real past remoteFrame, guesses after
+    uint32_t check[NET_HISTORY];        // RAM checksum at the end of each frame
+    SaveState saves[NET_HISTORY];       // state at the start of each frame
+
+    int32_t peerCheckFrame;     // newest final checksum from the remote
+    uint32_t peerCheck;
+    int32_t desyncFrame;        // first frame the checksums disagreed, -1 for none
+
+    uint32_t rollbacks;
+    uint32_t resimulated;       // frames run again after a rollback
+    uint32_t stalls;            // calls that waited on the remote
+} Netplay;
+
+// binds localPort and sends to host:remotePort, NULL on socket errors
+Netplay*    initializeNetplay(int player, int localPort, const char* host, int remotePort);
+void        freeNetplay(Netplay* np);
+
+/*
+    Runs the next frame with this peer's input. Returns 0 without running
+    anything when the remote is NET_MAX_AHEAD frames behind.
+*/
+int         netplayFrame(Netplay* np, CPUState* state, uint8_t input);
+
+// handles packets and any rollback they cause without running a new frame
+void        netplayPoll(Netplay* np, CPUState* state);
+
+// newest frame both peers have the inputs for
+int32_t     netplayConfirmed(Netplay* np);
+
+uint32_t    ramChecksum(CPUState* state);
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "cpu.h"
+#include "machine.h"
+#include "netplay.h"
+
+/*
+    Headless netplay peer driven by scripted inputs, for checking rollback
+    with two processes over loopback.
+
+    usage: netrun [-s] player localport host remoteport [frames]
+    -s paces frames at 60Hz instead of running flat out
+
+    e.g. ./netrun 0 7000 127.0.0.1 7001 & ./netrun 1 7001 127.0.0.1 7000
+*/
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// both players drop a coin, player 1 starts a two player game, then random play
+static uint8_t scriptedInput(int player, uint32_t frame) {
+    if (frame >= 60 && frame < 64)
+        return NET_COIN;
+    if (player == 1 && frame >= 90 && frame < 94)
+        return NET_COIN;
+    if (player == 1 && frame >= 130 && frame < 134)
+        return NET_START;
+    if (frame < 200)
+        return 0;
+    static const uint8_t moves[] = { 0, NET_FIRE, NET_LEFT, NET_RIGHT, NET_LEFT | NET_FIRE, NET_RIGHT | NET_FIRE };
+    // a new move every 10 frames
+    uint32_t x = (frame / 10 + player * 7919) * 2654435761u;
+    return moves[(x >> 16) % 6];
+}
+
+int main(int argc, char** argv) {
+    int paced = 0, arg = 1;
+    if (argc > 1 && strcmp(argv[1], "-s") == 0) {
+        paced = 1;
+        arg++;
+    }
+    if (argc - arg < 4) {
+        printf("usage: netrun [-s] player localport host remoteport [frames]\n");
+        return 1;
+    }
+    int player = atoi(argv[arg]);
+    int localPort = atoi(argv[arg + 1]);
+    char* host = argv[arg + 2];
+    int remotePort = atoi(argv[arg + 3]);
+    uint32_t frames = argc - arg > 4 ? atoi(argv[arg + 4]) : 3600;
+
+    CPUState* CPU = initializeCPU();
+    if (!loadInvaders(CPU)) {
+        printf("Error: can't read the ROM from ./rom\n");
+        return 1;
+    }
+    Netplay* np = initializeNetplay(player, localPort, host, remotePort);
+    if (np == NULL) {
+        printf("Error: can't open UDP port %d\n", localPort);
+        return 1;
+    }
+
+    double worst = 0, next = now();
+    while (np->frame < frames) {
+        if (paced) {
+            while (now() < next)
+                usleep(500);
+            next += 1.0 / FRAME_HZ;
+        }
+        uint32_t rollbacks = np->rollbacks;
+        double start = now();
+        if (!netplayFrame(np, CPU, scriptedInput(player, np->frame))) {
+            usleep(200);
+            continue;
+        }
+        // only a frame that rolled back says anything about the resimulation cost
+        if (np->rollbacks != rollbacks && now() - start > worst)
+            worst = now() - start;
+    }
+
+    // wait for the last remote inputs, then give the remote time to get ours
+    double deadline = now() + 5;
+    while ((netplayConfirmed(np) < (int32_t) frames - 1 || np->remoteAck < (int32_t) frames - 1) && now() < deadline) {
+        netplayPoll(np, CPU);
+        usleep(200);
+    }
+    for (int i = 0; i < 50; i++) {
+        netplayPoll(np, CPU);
+        usleep(10000);
+    }
+
+    printf("player %d: %u frames, %u rollbacks, %u frames resimulated, %u stalls, worst rollback frame %.2fms\n",
+        player, np->frame, np->rollbacks, np->resimulated, np->stalls, worst * 1000);
+    printf("player %d: checksum %08x at frame %d, %s\n", player,
+        np->check[(frames - 1) % NET_HISTORY], frames - 1,
+        np->desyncFrame < 0 ? "in sync" : "DESYNC");
+    if (np->desyncFrame >= 0)
+        printf("player %d: first desync at frame %d\n", player, np->desyncFrame);
+    return np->desyncFrame >= 0;
+}
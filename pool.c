@@ -0,0 +1,50 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "machine.h"
+#include "pool.h"
+
+#define STATE_BYTES ((sizeof(CPUState) + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN)
+
+InstancePool* initializePool(int capacity, CPUState* golden) {
+    InstancePool* pool = calloc(1, sizeof(InstancePool));
+    pool->capacity = capacity;
+    pool->stride = STATE_BYTES + 0x10000;
+    pool->block = aligned_alloc(POOL_ALIGN, (size_t) capacity * pool->stride);
+    pool->free = malloc(capacity * sizeof(int));
+    saveState(golden, &pool->golden);
+
+    for (int i = 0; i < capacity; i++) {
+        CPUState* state = poolInstance(pool, i);
+        memset(state, 0, STATE_BYTES);
+        state->mem = (uint8_t*) state + STATE_BYTES;
+        state->map = golden->map;
+        memcpy(state->mem, golden->mem, 0x10000);
+        loadState(state, &pool->golden);
+        pool->free[capacity - 1 - i] = i;
+    }
+    pool->freeCount = capacity;
+    return pool;
+}
+
+void freePool(InstancePool* pool) {
+    free(pool->block);
+    free(pool->free);
+    free(pool);
+}
+
+CPUState* acquireInstance(InstancePool* pool) {
+    if (pool->freeCount == 0)
+        return NULL;
+    CPUState* state = poolInstance(pool, pool->free[--pool->freeCount]);
+    resetInstance(pool, state);
+    return state;
+}
+
+void releaseInstance(InstancePool* pool, CPUState* state) {
+    pool->free[pool->freeCount++] = ((uint8_t*) state - pool->block) / pool->stride;
+}
+
+void resetInstance(InstancePool* pool, CPUState* state) {
+    loadState(state, &pool->golden);
+}
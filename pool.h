@@ -0,0 +1,44 @@
+#ifndef __pool_h__
+#define __pool_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cpu.h"
+#include "machine.h"
+
+#define POOL_ALIGN 64               // cache line
+
+/*
+    A fixed number of machines in one aligned block, each a CPUState
+    padded to a cache line followed by its 64KB, so no two instances
+    share a line and nothing is allocated after the pool is made. Every
+    instance starts as a copy of the golden machine and reset puts its
+    registers and RAM back in place, 8KB of copying, which is all that
+    can differ: ROM never changes and ROM writes go to a page nothing
+    reads. Free instances are handed out lowest index first.
+*/
+typedef struct InstancePool {
+    int capacity;
+    size_t stride;                  // bytes per instance
+    uint8_t* block;
+    SaveState golden;               // what an instance is reset to
+    int* free;                      // stack of unused indexes, lowest on top
+    int freeCount;
+} InstancePool;
+
+// every instance gets golden's 64KB, registers and map
+InstancePool*   initializePool(int capacity, CPUState* golden);
+void            freePool(InstancePool* pool);
+
+// a freshly reset instance, NULL when all are in use
+CPUState*       acquireInstance(InstancePool* pool);
+void            releaseInstance(InstancePool* pool, CPUState* state);
+
+// back to the golden machine without allocating
+void            resetInstance(InstancePool* pool, CPUState* state);
+
+static inline CPUState* poolInstance(InstancePool* pool, int index) {
+    return (CPUState*) (pool->block + (size_t) index * pool->stride);
+}
+
+#endif
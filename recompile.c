@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "cpu.h"
+#include "disassembler.h"
+
+/*
+    Static recompiler: walks the invaders ROM from its entry points and
+    writes a C file with one function per basic block plus a dispatch
+    table, see compiled.h. Anything it can't translate is left to the
+    interpreter.
+
+    usage: recompile rom/invaders > invaders_rec.c
+*/
+
+#define ROM_SIZE 0x2000
+
+static uint8_t rom[0x10000];
+static uint8_t leader[ROM_SIZE];   // 1 if a block starts here
+static uint16_t worklist[ROM_SIZE];
+static int pending;
+
+// 3 bit register fields in opcodes, 6 is (HL) and only works as a source
+static const char* reg[8] = {
+    "state->b", "state->c", "state->d", "state->e",
+    "state->h", "state->l", "readByte(state, HL)", "state->a"
+};
+
+// condition field of Jcc/Ccc/Rcc: NZ, Z, NC, C, PO, PE, P, M
+static const char* cond[8] = {
+    "!state->flags.z", "state->flags.z", "!state->flags.c", "state->flags.c",
+    "!state->flags.p", "state->flags.p", "!state->flags.s", "state->flags.s"
+};
+
+// ALU ops 0x80..0xbf and their immediate forms, see cpu.h
+static const char* alu[8] = { "add", "adc", "sub", "sbb", "ana", "xra", "ora", "cmp" };
+
+// ops left to the interpreter: DAA, HLT, DI, RST n and the undocumented ones
+static int translatable(uint8_t op) {
+    switch (op) {
+        case 0x08: case 0x10: case 0x18: case 0x20:
+        case 0x28: case 0x30: case 0x38:
+        case 0xcb: case 0xd9: case 0xdd: case 0xed: case 0xfd:
+        case 0x27: case 0x76: case 0xf3:
+            return 0;
+    }
+    return (op & 0xc7) != 0xc7;
+}
+
+static void addLeader(uint32_t addr) {
+    if (addr >= ROM_SIZE || leader[addr])
+        return;
+    leader[addr] = 1;
+    worklist[pending++] = addr;
+}
+
+static uint16_t target(uint16_t pc) {
+    return rom[pc+2] << 8 | rom[pc+1];
+}
+
+// follows straight-line code from pc, queueing every address control can reach
+static void scanBlock(uint16_t pc) {
+    while (pc < ROM_SIZE) {
+        uint8_t op = rom[pc];
+        uint16_t next = pc + Disassemble8080To(NULL, rom, pc);
+
+        if (!translatable(op)) {
+            if (op != 0x76)
+                addLeader(next);    // resume compiled code after the interpreter runs it
+            return;
+        }
+        if (op == 0xc3) {                           // JMP
+            addLeader(target(pc));
+            return;
+        } else if ((op & 0xc7) == 0xc2 || (op & 0xc7) == 0xc4 || op == 0xcd) {
+            addLeader(target(pc));                  // Jcc, Ccc, CALL
+            addLeader(next);
+            return;
+        } else if ((op & 0xc7) == 0xc0) {           // Rcc
+            addLeader(next);
+            return;
+        } else if (op == 0xc9 || op == 0xe9) {      // RET, PCHL
+            return;
+        }
+        if (next < ROM_SIZE && leader[next])
+            return;
+        pc = next;
+    }
+}
+
+// writes the C for one instruction, returns 0 if it ended the block
+static int emitOp(FILE* out, uint16_t pc, int total) {
+    uint8_t op = rom[pc];
+    uint8_t d8 = rom[pc+1];
+    uint16_t next = pc + Disassemble8080To(NULL, rom, pc);
+    uint16_t adr = target(pc);
+
+    if (op >= 0x70 && op < 0x78) {                  // MOV M,r
+        fprintf(out, "    writeByte(state, HL, %s);\n", reg[op & 7]);
+        return 1;
+    }
+    if (op >= 0x40 && op < 0x80) {                  // MOV
+        fprintf(out, "    %s = %s;\n", reg[(op >> 3) & 7], reg[op & 7]);
+        return 1;
+    }
+    if (op >= 0x80 && op < 0xc0) {                  // ALU r
+        fprintf(out, "    %s(state, %s);\n", alu[(op >> 3) & 7], reg[op & 7]);
+        return 1;
+    }
+    if (op == 0x36) {                               // MVI M
+        fprintf(out, "    writeByte(state, HL, 0x%02x);\n", d8);
+        return 1;
+    }
+    if ((op & 0xc7) == 0x06) {                      // MVI
+        fprintf(out, "    %s = 0x%02x;\n", reg[(op >> 3) & 7], d8);
+        return 1;
+    }
+    if ((op & 0xc7) == 0xc6) {                      // ALU d8
+        fprintf(out, "    %s(state, 0x%02x);\n", alu[(op >> 3) & 7], d8);
+        return 1;
+    }
+    if (op == 0x34 || op == 0x35) {                 // INR M, DCR M
+        fprintf(out, "    {\n        uint8_t m = readByte(state, HL);\n        %s;\n        writeByte(state, HL, m);\n    }\n",
+            op == 0x34 ? "inr(state, &m)" : "dcr(&m, state)");
+        return 1;
+    }
+    if ((op & 0xc7) == 0x04) {                      // INR
+        fprintf(out, "    inr(state, &%s);\n", reg[(op >> 3) & 7]);
+        return 1;
+    }
+    if ((op & 0xc7) == 0x05) {                      // DCR
+        fprintf(out, "    dcr(&%s, state);\n", reg[(op >> 3) & 7]);
+        return 1;
+    }
+    if ((op & 0xc7) == 0xc2) {                      // Jcc
+        fprintf(out, "    syncFlags(state);\n");
+        fprintf(out, "    if (%s) {\n        state->pc = 0x%04x;\n        return %d;\n    }\n",
+            cond[(op >> 3) & 7], adr, total);
+        fprintf(out, "    state->pc = 0x%04x;\n    return %d;\n", next, total);
+        return 0;
+    }
+    if ((op & 0xc7) == 0xc4) {                      // Ccc
+        fprintf(out, "    syncFlags(state);\n");
+        fprintf(out, "    if (%s) {\n        push(state, 0x%04x);\n        state->pc = 0x%04x;\n        return %d;\n    }\n",
+            cond[(op >> 3) & 7], next, adr, total);
+        fprintf(out, "    state->pc = 0x%04x;\n    return %d;\n", next, total);
+        return 0;
+    }
+    if ((op & 0xc7) == 0xc0) {                      // Rcc
+        fprintf(out, "    syncFlags(state);\n");
+        fprintf(out, "    if (%s) {\n        state->pc = readWord(state, state->sp);\n"
+            "        state->sp += 2;\n        return %d;\n    }\n", cond[(op >> 3) & 7], total);
+        fprintf(out, "    state->pc = 0x%04x;\n    return %d;\n", next, total);
+        return 0;
+    }
+
+    switch (op) {
+        case 0x00: break;
+        case 0x01: fprintf(out, "    state->b = 0x%02x;\n    state->c = 0x%02x;\n", adr >> 8, adr & 0xff); break;
+        case 0x11: fprintf(out, "    state->d = 0x%02x;\n    state->e = 0x%02x;\n", adr >> 8, adr & 0xff); break;
+        case 0x21: fprintf(out, "    state->h = 0x%02x;\n    state->l = 0x%02x;\n", adr >> 8, adr & 0xff); break;
+        case 0x31: fprintf(out, "    state->sp = 0x%04x;\n", adr); break;
+        case 0x02: fprintf(out, "    writeByte(state, state->b << 8 | state->c, state->a);\n"); break;
+        case 0x12: fprintf(out, "    writeByte(state, state->d << 8 | state->e, state->a);\n"); break;
+        case 0x0a: fprintf(out, "    state->a = readByte(state, state->b << 8 | state->c);\n"); break;
+        case 0x1a: fprintf(out, "    state->a = readByte(state, state->d << 8 | state->e);\n"); break;
+        case 0x03: fprintf(out, "    if (++state->c == 0)\n        state->b++;\n"); break;
+        case 0x13: fprintf(out, "    if (++state->e == 0)\n        state->d++;\n"); break;
+        case 0x23: fprintf(out, "    if (++state->l == 0)\n        state->h++;\n"); break;
+        case 0x33: fprintf(out, "    state->sp += 1;\n"); break;
+        case 0x0b: fprintf(out, "    dcx(&state->b, &state->c);\n"); break;
+        case 0x1b: fprintf(out, "    dcx(&state->d, &state->e);\n"); break;
+        case 0x2b: fprintf(out, "    dcx(&state->h, &state->l);\n"); break;
+        case 0x3b: fprintf(out, "    state->sp -= 1;\n"); break;
+        case 0x09: fprintf(out, "    dad(state, state->b << 8 | state->c);\n"); break;
+        case 0x19: fprintf(out, "    dad(state, state->d << 8 | state->e);\n"); break;
+        case 0x29: fprintf(out, "    dad(state, HL);\n"); break;
+        case 0x39: fprintf(out, "    dad(state, state->sp);\n"); break;
+        case 0x07: fprintf(out, "    syncFlags(state);\n    state->flags.c = state->a >> 7;\n"
+                                "    state->a = state->a << 1 | state->flags.c;\n"); break;
+        case 0x0f: fprintf(out, "    syncFlags(state);\n    state->flags.c = state->a & 1;\n"
+                                "    state->a = state->flags.c << 7 | state->a >> 1;\n"); break;
+        case 0x17: fprintf(out, "    {\n        uint8_t msb = state->a >> 7;\n        syncFlags(state);\n"
+                                "        state->a = state->a << 1 | state->flags.c;\n        state->flags.c = msb;\n    }\n"); break;
+        case 0x1f: fprintf(out, "    {\n        uint8_t lsb = state->a & 1;\n        syncFlags(state);\n"
+                                "        state->a = state->a >> 1 | state->flags.c << 7;\n        state->flags.c = lsb;\n    }\n"); break;
+        case 0x22: fprintf(out, "    writeByte(state, 0x%04x, state->l);\n    writeByte(state, 0x%04x, state->h);\n", adr, (uint16_t) (adr+1)); break;
+        case 0x2a: fprintf(out, "    state->l = readByte(state, 0x%04x);\n    state->h = readByte(state, 0x%04x);\n", adr, (uint16_t) (adr+1)); break;
+        case 0x32: fprintf(out, "    writeByte(state, 0x%04x, state->a);\n", adr); break;
+        case 0x3a: fprintf(out, "    state->a = readByte(state, 0x%04x);\n", adr); break;
+        case 0x2f: fprintf(out, "    state->a = ~state->a;\n"); break;
+        case 0x37: fprintf(out, "    syncFlags(state);\n    state->flags.c = 1;\n"); break;
+        case 0x3f: fprintf(out, "    syncFlags(state);\n    state->flags.c = !state->flags.c;\n"); break;
+        case 0xc1: fprintf(out, "    state->c = readByte(state, state->sp);\n    state->b = readByte(state, state->sp+1);\n    state->sp += 2;\n"); break;
+        case 0xd1: fprintf(out, "    state->e = readByte(state, state->sp);\n    state->d = readByte(state, state->sp+1);\n    state->sp += 2;\n"); break;
+        case 0xe1: fprintf(out, "    state->l = readByte(state, state->sp);\n    state->h = readByte(state, state->sp+1);\n    state->sp += 2;\n"); break;
+        case 0xf1:
+            fprintf(out, "    {\n        uint8_t psw = readByte(state, state->sp);\n");
+            fprintf(out, "#ifdef LAZY_FLAGS\n        state->lazy.op = LAZY_NONE;\n#endif\n");
+            fprintf(out, "        state->flags.c = psw & 1;\n        state->flags.p = (psw >> 1) & 1;\n"
+                         "        state->flags.ac = (psw >> 2) & 1;\n        state->flags.z = (psw >> 3) & 1;\n"
+                         "        state->flags.s = (psw >> 4) & 1;\n        state->a = readByte(state, state->sp+1);\n"
+                         "        state->sp += 2;\n    }\n");
+            break;
+        case 0xc5: fprintf(out, "    push(state, state->b << 8 | state->c);\n"); break;
+        case 0xd5: fprintf(out, "    push(state, state->d << 8 | state->e);\n"); break;
+        case 0xe5: fprintf(out, "    push(state, HL);\n"); break;
+        case 0xf5:
+            fprintf(out, "    syncFlags(state);\n");
+            fprintf(out, "    push(state, state->a << 8 | state->flags.c | state->flags.p << 1 | state->flags.ac << 2 |\n"
+                         "        state->flags.z << 3 | state->flags.s << 4);\n");
+            break;
+        case 0xe3:
+            fprintf(out, "    {\n        uint8_t temp = readByte(state, state->sp+1);\n        writeByte(state, state->sp+1, state->h);\n"
+                         "        state->h = temp;\n        temp = readByte(state, state->sp);\n        writeByte(state, state->sp, state->l);\n"
+                         "        state->l = temp;\n    }\n");
+            break;
+        case 0xeb:
+            fprintf(out, "    {\n        uint8_t temp = state->d;\n        state->d = state->h;\n        state->h = temp;\n"
+                         "        temp = state->e;\n        state->e = state->l;\n        state->l = temp;\n    }\n");
+            break;
+        case 0xf9: fprintf(out, "    state->sp = HL;\n"); break;
+        case 0xfb: fprintf(out, "    state->int_enable = 1;\n"); break;
+        case 0xdb: fprintf(out, "    state->a = machineIN(state, 0x%02x);\n", d8); break;
+        case 0xd3: fprintf(out, "    machineOUT(state, 0x%02x);\n", d8); break;
+        case 0xc3:
+            fprintf(out, "    state->pc = 0x%04x;\n    return %d;\n", adr, total);
+            return 0;
+        case 0xcd:
+            fprintf(out, "    push(state, 0x%04x);\n    state->pc = 0x%04x;\n    return %d;\n", next, adr, total);
+            return 0;
+        case 0xc9:
+            fprintf(out, "    state->pc = readWord(state, state->sp);\n"
+                         "    state->sp += 2;\n    return %d;\n", total);
+            return 0;
+        case 0xe9:
+            fprintf(out, "    state->pc = HL;\n    return %d;\n", total);
+            return 0;
+    }
+    return 1;
+}
+
+static void emitBlock(FILE* out, uint16_t start) {
+    uint16_t pc = start;
+    int total = 0;
+
+    fprintf(out, "static int blk_%04x(CPUState* state) {\n", start);
+    for (;;) {
+        fprintf(out, "    // ");
+        uint16_t next = pc + Disassemble8080To(out, rom, pc);
+        fprintf(out, "\n");
+        total += cycles8080[rom[pc]];
+        if (!emitOp(out, pc, total))
+            break;
+        if (next >= ROM_SIZE || leader[next] || !translatable(rom[next])) {
+            fprintf(out, "    state->pc = 0x%04x;\n    return %d;\n", next, total);
+            break;
+        }
+        pc = next;
+    }
+    fprintf(out, "}\n\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: %s rom > out.c\n", argv[0]);
+        return 1;
+    }
+    FILE* fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        printf("Error: Invalid file %s", argv[1]);
+        return 1;
+    }
+    fread(rom, 1, ROM_SIZE, fp);
+    fclose(fp);
+
+    // reset, RST 1 (mid-screen) and RST 2 (vblank)
+    addLeader(0x0000);
+    addLeader(0x0008);
+    addLeader(0x0010);
+    while (pending)
+        scanBlock(worklist[--pending]);
+
+    FILE* out = stdout;
+    int count = 0;
+    fprintf(out, "// generated by recompile from %s, do not edit\n", argv[1]);
+    fprintf(out, "#include \"cpu.h\"\n#include \"machine.h\"\n#include \"memmap.h\"\n#include \"compiled.h\"\n\n");
+    fprintf(out, "#define HL (state->h << 8 | state->l)\n\n");
+    for (int pc = 0; pc < ROM_SIZE; pc++) {
+        if (leader[pc] && translatable(rom[pc])) {
+            emitBlock(out, pc);
+            count++;
+        }
+    }
+
+    fprintf(out, "static int (*const blocks[0x%04x])(CPUState* state) = {\n", ROM_SIZE);
+    for (int pc = 0; pc < ROM_SIZE; pc++) {
+        if (leader[pc] && translatable(rom[pc]))
+            fprintf(out, "    [0x%04x] = blk_%04x,\n", pc, pc);
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out, "const int compiledBlocks = %d;\n\n", count);
+    fprintf(out, "int stepCompiled(CPUState* state) {\n");
+    fprintf(out, "    if (state->pc < 0x%04x && blocks[state->pc])\n", ROM_SIZE);
+    fprintf(out, "        return blocks[state->pc](state);\n");
+    fprintf(out, "    return stepMachine(state);\n}\n");
+    return 0;
+}
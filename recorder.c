@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "cpu.h"
+#include "machine.h"
+#include "disassembler.h"
+#include "recorder.h"
+
+static Recorder* active;
+
+int stepRecorded(CPUState* state) {
+    Recorder* rec = active;
+    TraceEntry* t = &rec->ring[rec->count++ & (RECORDER_SIZE - 1)];
+    uint8_t* op = &state->mem[state->pc];
+    uint8_t flags;
+    memcpy(&flags, &state->flags, 1);
+    t->cycle = rec->cycles;
+    t->regs = (uint64_t) state->b | (uint64_t) state->c << 8 | (uint64_t) state->d << 16 |
+              (uint64_t) state->e << 24 | (uint64_t) state->h << 32 | (uint64_t) state->l << 40 |
+              (uint64_t) state->a << 48 | (uint64_t) flags << 56;
+    t->at = (uint64_t) state->pc | (uint64_t) state->sp << 16 | (uint64_t) op[0] << 32 |
+            (uint64_t) op[1] << 40 | (uint64_t) op[2] << 48;
+    rec->state = state;
+
+    int cycles = stepMachine(state);
+    rec->cycles += cycles;
+    return cycles;
+}
+
+int dumpRecorder(Recorder* rec, const char* reason) {
+    char path[300];
+    snprintf(path, sizeof(path), "%s.trace", rec->prefix);
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+        return 0;
+
+    uint64_t first = rec->count > RECORDER_SIZE ? rec->count - RECORDER_SIZE : 0;
+    fprintf(out, "%s after %llu instructions, %llu cycles\n", reason,
+        (unsigned long long) rec->count, (unsigned long long) rec->cycles);
+    fprintf(out, "%-14s %-8s%-24s a  b  c  d  e  h  l  f  sp\n", "cycle", "pc", "");
+    for (uint64_t i = first; i < rec->count; i++) {
+        TraceEntry* t = &rec->ring[i & (RECORDER_SIZE - 1)];
+        uint8_t r[8], op[3];
+        for (int j = 0; j < 8; j++)
+            r[j] = t->regs >> (j * 8);
+        for (int j = 0; j < 3; j++)
+            op[j] = t->at >> (32 + j * 8);
+        FlagRegister flags;
+        memcpy(&flags, &r[7], 1);
+
+        fprintf(out, "%-14llu ", (unsigned long long) t->cycle);
+        Disassemble8080Op(out, op, t->at & 0xffff);
+        // flags in the PUSH PSW layout
+        fprintf(out, "%02x %02x %02x %02x %02x %02x %02x %02x %04x\n", r[6], r[0], r[1], r[2], r[3], r[4], r[5],
+            flags.c | flags.p << 1 | flags.ac << 2 | flags.z << 3 | flags.s << 4, (int) (t->at >> 16) & 0xffff);
+    }
+    fclose(out);
+
+    if (rec->state == NULL)
+        return 1;
+    snprintf(path, sizeof(path), "%s.state", rec->prefix);
+    return saveStateFile(rec->state, path);
+}
+
+static void onFault(CPUState* state) {
+    (void) state;
+    dumpRecorder(active, "unimplemented instruction");
+}
+
+/*
+    Not async-signal-safe, stdio in a handler can deadlock if the signal
+    hit inside it. For a crash that's already going down it's worth the
+    chance of getting the trace out.
+*/
+static void onSignal(int sig) {
+    char reason[64];
+    snprintf(reason, sizeof(reason), "signal %d (%s)", sig, strsignal(sig));
+    dumpRecorder(active, reason);
+    if (sig == SIGUSR1)
+        return;
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+void startRecorder(Recorder* rec, const char* prefix) {
+    rec->count = 0;
+    rec->cycles = 0;
+    rec->state = NULL;
+    snprintf(rec->prefix, sizeof(rec->prefix), "%s", prefix);
+    active = rec;
+    faultHook = onFault;
+
+    int fatal[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+    for (size_t i = 0; i < sizeof(fatal) / sizeof(fatal[0]); i++)
+        signal(fatal[i], onSignal);
+    signal(SIGUSR1, onSignal);
+}
@@ -0,0 +1,45 @@
+#ifndef __recorder_h__
+#define __recorder_h__
+
+#include <stdint.h>
+#include "cpu.h"
+
+#define RECORDER_SIZE 4096      // instructions kept, a power of two
+
+/*
+    The machine as an instruction found it, packed into three words so a
+    record is three stores; byte by byte the stores cost more than the
+    instruction. regs holds b, c, d, e, h, l, a then the FlagRegister byte,
+    which may be stale in LAZY_FLAGS builds. at holds pc, sp and the three
+    op bytes, lowest first.
+*/
+typedef struct TraceEntry {
+    uint64_t cycle;             // clock cycles run before this instruction
+    uint64_t regs;
+    uint64_t at;
+} TraceEntry;
+
+/*
+    Flight recorder for crashes. stepRecorded notes every instruction in a
+    fixed ring before running it through stepMachine, cheap enough to leave
+    on. An unimplemented instruction, a fatal signal or SIGUSR1 writes
+    prefix.trace with the last RECORDER_SIZE instructions disassembled
+    and prefix.state with a save state to resume from. Only one recorder
+    runs at a time.
+*/
+typedef struct Recorder {
+    TraceEntry ring[RECORDER_SIZE];
+    uint64_t count;             // instructions recorded, the newest is count - 1
+    uint64_t cycles;
+    CPUState* state;            // last one stepped
+    char prefix[256];
+} Recorder;
+
+// installs the fault hook and signal handlers, stepRecorded then records into rec
+void    startRecorder(Recorder* rec, const char* prefix);
+int     stepRecorded(CPUState* state);
+
+// writes prefix.trace and prefix.state, returns 0 if either couldn't be written
+int     dumpRecorder(Recorder* rec, const char* reason);
+
+#endif
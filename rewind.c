@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu.h"
+#include "machine.h"
+#include "rewind.h"
+
+// record layout: packed registers, kind, then all of RAM or the encoded delta
+#define REGS_SIZE 20
+#define HEADER_SIZE (REGS_SIZE + 1)
+#define KIND_KEY 1
+#define KIND_DELTA 0
+
+// zero bytes it takes to end a literal run, shorter gaps are cheaper to copy
+#define MIN_GAP 4
+
+Rewind* initializeRewind(uint32_t bytes, int frames, int interval) {
+    Rewind* rw = calloc(1, sizeof(Rewind));
+    rw->interval = interval < 1 ? 1 : interval;
+    rw->size = bytes;
+    rw->data = malloc(bytes);
+    rw->capacity = frames;
+    rw->records = malloc(frames * sizeof(RewindRecord));
+    rw->scratch = malloc(RAM_SIZE);
+    return rw;
+}
+
+void freeRewind(Rewind* rw) {
+    free(rw->data);
+    free(rw->records);
+    free(rw->scratch);
+    free(rw);
+}
+
+static inline RewindRecord* record(Rewind* rw, int i) {
+    return &rw->records[(rw->first + i) % rw->capacity];
+}
+
+static inline int isKey(Rewind* rw, int i) {
+    return rw->data[record(rw, i)->offset + REGS_SIZE] == KIND_KEY;
+}
+
+// flags go in the same layout PUSH PSW uses
+static void packRegs(CPUState* state, uint8_t* out) {
+    syncFlags(state);
+    out[0] = state->a;
+    out[1] = state->b;
+    out[2] = state->c;
+    out[3] = state->d;
+    out[4] = state->e;
+    out[5] = state->h;
+    out[6] = state->l;
+    out[7] = state->flags.c | state->flags.p << 1 | state->flags.ac << 2 |
+             state->flags.z << 3 | state->flags.s << 4;
+    out[8] = state->pc & 0xff;
+    out[9] = state->pc >> 8;
+    out[10] = state->sp & 0xff;
+    out[11] = state->sp >> 8;
+    out[12] = state->int_enable;
+    out[13] = state->ports.read1;
+    out[14] = state->ports.read2;
+    out[15] = state->ports.read3 & 0xff;
+    out[16] = state->ports.read3 >> 8;
+    out[17] = state->ports.write2;
+    out[18] = state->ports.write3;
+    out[19] = state->ports.write5;
+}
+
+static void unpackRegs(CPUState* state, uint8_t* in) {
+    state->a = in[0];
+    state->b = in[1];
+    state->c = in[2];
+    state->d = in[3];
+    state->e = in[4];
+    state->h = in[5];
+    state->l = in[6];
+    state->flags.c = in[7] & 1;
+    state->flags.p = (in[7] >> 1) & 1;
+    state->flags.ac = (in[7] >> 2) & 1;
+    state->flags.z = (in[7] >> 3) & 1;
+    state->flags.s = (in[7] >> 4) & 1;
+#ifdef LAZY_FLAGS
+    state->lazy.op = LAZY_NONE;
+#endif
+    state->pc = in[8] | in[9] << 8;
+    state->sp = in[10] | in[11] << 8;
+    state->int_enable = in[12];
+    state->ports.read1 = in[13];
+    state->ports.read2 = in[14];
+    state->ports.read3 = in[15] | in[16] << 8;
+    state->ports.write2 = in[17];
+    state->ports.write3 = in[18];
+    state->ports.write5 = in[19];
+}
+
+// lengths and skips below 128 take one byte
+static inline int putVarint(uint8_t* out, int n, int x) {
+    if (x < 0x80) {
+        out[n++] = x;
+    } else {
+        out[n++] = 0x80 | (x & 0x7f);
+        out[n++] = x >> 7;
+    }
+    return n;
+}
+
+static inline int getVarint(uint8_t* in, int* i) {
+    int x = in[(*i)++];
+    if (x & 0x80)
+        x = (x & 0x7f) | in[(*i)++] << 7;
+    return x;
+}
+
+/*
+    XORs ram against the previous frame and writes runs of
+    (skip, length, bytes) with varint skip and length. Returns -1 once the
+    delta would be no smaller than a keyframe.
+*/
+static int encodeDelta(uint8_t* ram, uint8_t* last, uint8_t* out) {
+    int n = 0, i = 0, skip = 0;
+    while (i < RAM_SIZE) {
+        if (ram[i] == last[i]) {
+            skip++;
+            i++;
+            continue;
+        }
+
+        int start = i, gap = 0;
+        while (i < RAM_SIZE && gap < MIN_GAP) {
+            gap = ram[i] == last[i] ? gap + 1 : 0;
+            i++;
+        }
+        int len = i - start - gap;
+        if (n + 4 + len >= RAM_SIZE)
+            return -1;
+
+        n = putVarint(out, n, skip);
+        n = putVarint(out, n, len);
+        for (int j = 0; j < len; j++)
+            out[n++] = ram[start + j] ^ last[start + j];
+        skip = gap;
+    }
+    return n;
+}
+
+static void applyDelta(uint8_t* ram, uint8_t* in, int n) {
+    int i = 0, addr = 0;
+    while (i < n) {
+        addr += getVarint(in, &i);
+        int len = getVarint(in, &i);
+        for (int j = 0; j < len; j++)
+            ram[addr++] ^= in[i++];
+    }
+}
+
+// drops the oldest keyframe and the deltas that depend on it
+static void dropGroup(Rewind* rw) {
+    do {
+        rw->used -= record(rw, 0)->length;
+        rw->first = (rw->first + 1) % rw->capacity;
+        rw->firstFrame++;
+        rw->count--;
+    } while (rw->count > 0 && !isKey(rw, 0));
+}
+
+// makes room for length bytes at pos, returns 0 if that emptied the ring
+static int reserve(Rewind* rw, uint32_t length) {
+    if (rw->pos + length > rw->size) {
+        // the records between pos and the end are the oldest, they go first
+        while (rw->count > 0 && record(rw, 0)->offset >= rw->pos)
+            dropGroup(rw);
+        rw->pos = 0;
+    }
+    while (rw->count > 0) {
+        RewindRecord* old = record(rw, 0);
+        int overlaps = old->offset < rw->pos + length && rw->pos < old->offset + old->length;
+        if (!overlaps && rw->count < rw->capacity)
+            break;
+        dropGroup(rw);
+    }
+    return rw->count > 0;
+}
+
+void rewindPush(Rewind* rw, CPUState* state) {
+    uint8_t* ram = state->mem + RAM_START;
+    int key = rw->count == 0 || rw->sinceKey >= rw->interval - 1;
+    int n = 0;
+    if (!key) {
+        n = encodeDelta(ram, rw->last, rw->scratch);
+        key = n < 0;
+    }
+    // a delta is useless if making room for it dropped its keyframe
+    if (!key && !reserve(rw, HEADER_SIZE + n))
+        key = 1;
+    if (key)
+        reserve(rw, HEADER_SIZE + RAM_SIZE);
+
+    uint32_t length = HEADER_SIZE + (key ? RAM_SIZE : n);
+    if (length > rw->size) {
+        printf("Error: rewind buffer smaller than one keyframe\n");
+        exit(1);
+    }
+
+    uint8_t* out = &rw->data[rw->pos];
+    packRegs(state, out);
+    out[REGS_SIZE] = key ? KIND_KEY : KIND_DELTA;
+    memcpy(out + HEADER_SIZE, key ? ram : rw->scratch, length - HEADER_SIZE);
+
+    RewindRecord* rec = record(rw, rw->count);
+    rec->offset = rw->pos;
+    rec->length = length;
+    rw->count++;
+    rw->pos += length;
+    rw->used += length;
+    rw->sinceKey = key ? 0 : rw->sinceKey + 1;
+    memcpy(rw->last, ram, RAM_SIZE);
+}
+
+uint64_t rewindOldest(Rewind* rw) {
+    return rw->firstFrame;
+}
+
+uint64_t rewindNewest(Rewind* rw) {
+    return rw->firstFrame + rw->count - 1;
+}
+
+int rewindTo(Rewind* rw, uint64_t frame, CPUState* state) {
+    if (rw->count == 0 || frame < rw->firstFrame || frame > rewindNewest(rw))
+        return 0;
+
+    int target = frame - rw->firstFrame;
+    int key = target;
+    while (!isKey(rw, key))
+        key--;
+
+    uint8_t* ram = state->mem + RAM_START;
+    memcpy(ram, &rw->data[record(rw, key)->offset + HEADER_SIZE], RAM_SIZE);
+    for (int i = key + 1; i <= target; i++) {
+        RewindRecord* rec = record(rw, i);
+        applyDelta(ram, &rw->data[rec->offset + HEADER_SIZE], rec->length - HEADER_SIZE);
+    }
+
+    RewindRecord* rec = record(rw, target);
+    unpackRegs(state, &rw->data[rec->offset]);
+
+    // everything after frame is history that no longer happened
+    for (int i = target + 1; i < rw->count; i++)
+        rw->used -= record(rw, i)->length;
+    rw->count = target + 1;
+    rw->pos = rec->offset + rec->length;
+    rw->sinceKey = target - key;
+    memcpy(rw->last, ram, RAM_SIZE);
+    return 1;
+}
+
+uint32_t rewindUsage(Rewind* rw) {
+    return rw->used;
+}
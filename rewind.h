@@ -0,0 +1,61 @@
+#ifndef __rewind_h__
+#define __rewind_h__
+
+#include <stdint.h>
+#include "cpu.h"
+#include "machine.h"
+
+// where one frame's record sits in the byte ring
+typedef struct RewindRecord {
+    uint32_t offset;
+    uint32_t length;
+} RewindRecord;
+
+/*
+    Fixed size history of the machine, one record per frame. Every
+    interval frames the record holds all of RAM, in between only the
+    bytes that changed, XORed against the frame before and run length
+    encoded. Restoring a frame costs one keyframe copy plus at most
+    interval - 1 deltas. When the ring is full the oldest keyframe and
+    its deltas are dropped together.
+*/
+typedef struct Rewind {
+    int interval;           // frames per keyframe
+    int sinceKey;
+
+    uint8_t* data;          // byte ring holding the records
+    uint32_t size;
+    uint32_t pos;           // where the next record goes
+    uint32_t used;
+
+    RewindRecord* records;  // ring of records, oldest at first
+    int capacity;
+    int first;
+    int count;
+    uint64_t firstFrame;    // frame number of the oldest record
+
+    uint8_t last[RAM_SIZE]; // RAM of the newest frame, deltas are taken against it
+    uint8_t* scratch;       // encoding buffer, worst case size
+} Rewind;
+
+Rewind*     initializeRewind(uint32_t bytes, int frames, int interval);
+void        freeRewind(Rewind* rw);
+
+// records the state at the end of a frame
+void        rewindPush(Rewind* rw, CPUState* state);
+
+// frame numbers of the oldest and newest records, only valid while count > 0
+uint64_t    rewindOldest(Rewind* rw);
+uint64_t    rewindNewest(Rewind* rw);
+
+/*
+    Puts state back to how it was at frame and forgets everything after,
+    so pushing carries on from there. Returns 0 if frame is outside the
+    window.
+*/
+int         rewindTo(Rewind* rw, uint64_t frame, CPUState* state);
+
+// bytes of the ring in use
+uint32_t    rewindUsage(Rewind* rw);
+
+#endif
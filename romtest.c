@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "cpu.h"
+#include "cpm.h"
+
+/*
+    Runs CP/M 8080 test programs (cpudiag, 8080PRE, TST8080, CPUTEST,
+    8080EXM...) on worker threads, each under the BDOS trap layer.
+
+    usage: romtest [-j workers] [-t seconds] [-n instructions] [-v] rom...
+    -j worker threads, defaults to the number of CPUs
+    -t wall time limit per program, default 600
+    -n instruction limit per program, default none
+    -v prints every program's output, not just failures
+
+    A program passes if it warm boots and never prints ERROR or FAIL.
+    The exit status is the number of programs that didn't pass.
+*/
+
+typedef struct Job {
+    const char* path;
+    CPM cpm;
+    int status;
+    int passed;
+    double secs;
+} Job;
+
+static Job* jobs;
+static int jobCount;
+static atomic_int nextJob;
+static uint64_t maxInstructions;
+static int timeoutMs = 600 * 1000;
+static int verbose;
+static pthread_mutex_t printLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* statusNames[] = { "running", "booted", "halted", "timeout" };
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(Job* job) {
+    pthread_mutex_lock(&printLock);
+    printf("%s  %-24s %8.2fs %14llu instructions  %s\n", job->passed ? "PASS" : "FAIL", job->path,
+        job->secs, (unsigned long long) job->cpm.instructions, statusNames[job->status]);
+    if (verbose || !job->passed) {
+        // indented so the program's output can't be mistaken for ours
+        printf("    ");
+        for (char* c = job->cpm.output; *c; c++) {
+            if (*c == '\n')
+                printf("\n    ");
+            else if (*c != '\r')
+                putchar(*c);
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(&printLock);
+}
+
+static void* worker(void* arg) {
+    (void) arg;
+    int i;
+    while ((i = atomic_fetch_add(&nextJob, 1)) < jobCount) {
+        Job* job = &jobs[i];
+        if (!initializeCPM(&job->cpm, job->path)) {
+            pthread_mutex_lock(&printLock);
+            printf("FAIL  %-24s can't read\n", job->path);
+            pthread_mutex_unlock(&printLock);
+            continue;
+        }
+        double start = now();
+        job->status = runCPM(&job->cpm, maxInstructions, timeoutMs);
+        job->secs = now() - start;
+        job->passed = job->status == CPM_BOOTED && !strstr(job->cpm.output, "ERROR") &&
+            !strstr(job->cpm.output, "FAIL");
+        report(job);
+        freeCPM(&job->cpm);
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    int workers = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = calloc(argc, sizeof(Job));
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            timeoutMs = atof(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            maxInstructions = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = 1;
+        } else {
+            jobs[jobCount++].path = argv[i];
+        }
+    }
+    if (jobCount == 0) {
+        printf("usage: romtest [-j workers] [-t seconds] [-n instructions] [-v] rom...\n");
+        return 1;
+    }
+    if (workers < 1)
+        workers = 1;
+    if (workers > jobCount)
+        workers = jobCount;
+
+    double start = now();
+    pthread_t* threads = malloc(workers * sizeof(pthread_t));
+    for (int i = 0; i < workers; i++)
+        pthread_create(&threads[i], NULL, worker, NULL);
+    for (int i = 0; i < workers; i++)
+        pthread_join(threads[i], NULL);
+
+    int failed = 0;
+    for (int i = 0; i < jobCount; i++)
+        failed += !jobs[i].passed;
+    printf("%d of %d passed in %.2fs on %d workers\n", jobCount - failed, jobCount, now() - start, workers);
+    return failed;
+}
@@ -0,0 +1,27 @@
+#include <string.h>
+#include "cpu.h"
+#include "machine.h"
+#include "runahead.h"
+
+void initializeRunAhead(RunAhead* ra, int frames) {
+    memset(ra, 0, sizeof(RunAhead));
+    ra->frames = frames < 0 ? 0 : frames;
+}
+
+void runAheadFrame(CPUState* state, RunAhead* ra, StepFn step) {
+    runFrameWith(state, step);
+    lookAhead(state, ra, step);
+}
+
+void lookAhead(CPUState* state, RunAhead* ra, StepFn step) {
+    if (ra->frames == 0) {
+        memcpy(ra->vram, &state->mem[VRAM_START], VRAM_SIZE);
+        return;
+    }
+
+    saveState(state, &ra->save);
+    for (int i = 0; i < ra->frames; i++)
+        runFrameWith(state, step);
+    memcpy(ra->vram, &state->mem[VRAM_START], VRAM_SIZE);
+    loadState(state, &ra->save);
+}
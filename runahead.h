@@ -0,0 +1,28 @@
+#ifndef __runahead_h__
+#define __runahead_h__
+
+#include <stdint.h>
+#include "cpu.h"
+#include "machine.h"
+
+/*
+    Hides the game's own input lag. Each real frame is saved, then the
+    machine runs frames more with the same inputs and the screen from
+    that future is what gets shown. The save is loaded back so the real
+    timeline never sees the speculative frames.
+*/
+typedef struct RunAhead {
+    int frames;                 // how far ahead the shown screen is, 0 is off
+    SaveState save;
+    uint8_t vram[VRAM_SIZE];    // screen to present this frame
+} RunAhead;
+
+void    initializeRunAhead(RunAhead* ra, int frames);
+
+// runs one real frame with step, leaves the screen to show in ra->vram
+void    runAheadFrame(CPUState* state, RunAhead* ra, StepFn step);
+
+// the second half of runAheadFrame, for a caller that ran the real frame itself
+void    lookAhead(CPUState* state, RunAhead* ra, StepFn step);
+
+#endif
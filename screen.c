@@ -0,0 +1,85 @@
+#include <stdint.h>
+#include <string.h>
+#include "screen.h"
+
+#define WHITE 0xffffffff
+#define RED 0xffff3030
+#define GREEN 0xff30ff30
+#define BLACK 0xff000000
+
+enum { INK_WHITE, INK_RED, INK_GREEN, INK_SHIPS };
+
+typedef uint8_t bytes4 __attribute__((vector_size(4)));
+typedef uint32_t pixels4 __attribute__((vector_size(16)));
+
+void initializeScreen(Screen* screen, int scale, int overlay) {
+    memset(screen, 0, sizeof(Screen));
+    screen->scale = scale < 1 ? 1 : scale > SCREEN_MAX_SCALE ? SCREEN_MAX_SCALE : scale;
+    screen->width = SCREEN_WIDTH * screen->scale;
+    screen->height = SCREEN_HEIGHT * screen->scale;
+    screen->paper = BLACK;
+
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        screen->ink[INK_WHITE][x] = WHITE;
+        screen->ink[INK_RED][x] = RED;
+        screen->ink[INK_GREEN][x] = GREEN;
+        screen->ink[INK_SHIPS][x] = x >= 16 && x < 134 ? GREEN : WHITE;
+    }
+    // upright rows, counted from the top
+    for (int y = 0; overlay && y < SCREEN_HEIGHT; y++) {
+        if (y >= 32 && y < 64)
+            screen->band[y] = INK_RED;
+        else if (y >= 184 && y < 240)
+            screen->band[y] = INK_GREEN;
+        else if (y >= 240)
+            screen->band[y] = INK_SHIPS;
+    }
+}
+
+// inlined once per scale so the widening shuffles are constants
+static inline __attribute__((always_inline)) void renderScaled(Screen* screen, const uint8_t* vram, void* pixels,
+    int pitch, const int scale) {
+    const pixels4 iota = { 0, 1, 2, 3 };
+    pixels4 line[SCREEN_WIDTH / 4 * SCREEN_MAX_SCALE];
+    uint8_t column[SCREEN_WIDTH];
+    pixels4 paper = (pixels4) {0} + screen->paper;
+
+    for (int j = 0; j < SCREEN_HEIGHT / 8; j++) {
+        // byte j of every VRAM column holds 8 upright rows
+        for (int x = 0; x < SCREEN_WIDTH; x++)
+            column[x] = vram[x * 32 + j];
+
+        for (int bit = 0; bit < 8; bit++) {
+            int y = SCREEN_HEIGHT - 1 - (j * 8 + bit);
+            const uint32_t* ink = screen->ink[screen->band[y]];
+            pixels4* out = line;
+            for (int x = 0; x < SCREEN_WIDTH; x += 4) {
+                bytes4 bytes;
+                pixels4 colour;
+                memcpy(&bytes, &column[x], sizeof(bytes));
+                memcpy(&colour, &ink[x], sizeof(colour));
+                pixels4 lit = -((__builtin_convertvector(bytes, pixels4) >> bit) & 1);
+                pixels4 px = (colour & lit) | (paper & ~lit);
+                #pragma GCC unroll 6
+                for (int k = 0; k < scale; k++)
+                    *out++ = __builtin_shuffle(px, (iota + 4 * k) / scale);
+            }
+
+            // the texture may be write combined, so every copy comes from line
+            uint8_t* row = (uint8_t*) pixels + (size_t) y * scale * pitch;
+            for (int r = 0; r < scale; r++)
+                memcpy(row + (size_t) r * pitch, line, SCREEN_WIDTH * scale * sizeof(uint32_t));
+        }
+    }
+}
+
+void renderScreen(Screen* screen, const uint8_t* vram, void* pixels, int pitch) {
+    switch (screen->scale) {
+        case 1: renderScaled(screen, vram, pixels, pitch, 1); break;
+        case 2: renderScaled(screen, vram, pixels, pitch, 2); break;
+        case 3: renderScaled(screen, vram, pixels, pitch, 3); break;
+        case 4: renderScaled(screen, vram, pixels, pitch, 4); break;
+        case 5: renderScaled(screen, vram, pixels, pitch, 5); break;
+        case 6: renderScaled(screen, vram, pixels, pitch, 6); break;
+    }
+}
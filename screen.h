@@ -0,0 +1,35 @@
+#ifndef __screen_h__
+#define __screen_h__
+
+#include <stdint.h>
+
+// the monitor is mounted rotated, so the upright screen is taller than wide
+#define SCREEN_WIDTH 224
+#define SCREEN_HEIGHT 256
+#define SCREEN_MAX_SCALE 6
+
+/*
+    Turns 1 bit VRAM into the upright ARGB8888 picture, scale times the
+    size in both directions, with the cabinet's coloured gel strips over
+    the lit pixels: red across the saucer, green over the shields and the
+    player, and green over the spare ships at the bottom left. VRAM is
+    walked one byte column at a time, so each group of 8 upright rows is
+    built from 224 loads, then each row is coloured and widened a vector
+    of 4 pixels at a time, SSE2 is enough, and copied out scale times.
+*/
+typedef struct Screen {
+    int scale;
+    int width;                          // output pixels
+    int height;
+    uint32_t paper;                     // unlit
+    uint32_t ink[4][SCREEN_WIDTH];      // lit pixel colour of each kind of row
+    uint8_t band[SCREEN_HEIGHT];        // which ink each upright row uses
+} Screen;
+
+// scale is clamped to 1..SCREEN_MAX_SCALE, overlay 0 is plain white
+void    initializeScreen(Screen* screen, int scale, int overlay);
+
+// pitch is the bytes between output rows, e.g. of a locked texture
+void    renderScreen(Screen* screen, const uint8_t* vram, void* pixels, int pitch);
+
+#endif
@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "cpu.h"
+#include "machine.h"
+#include "env.h"
+#include "gamestate.h"
+#include "search.h"
+#include "pool.h"
+
+// worth more than any points a ship could win back in a short search
+#define SHIP_VALUE 1000
+
+// a thread and the pooled CPU it clones nodes into
+typedef struct SearchWorker {
+    Search* search;
+    CPUState* cpu;
+} SearchWorker;
+
+typedef struct Ranked {
+    int32_t score;
+    int index;
+} Ranked;
+
+static inline uint32_t xorshift(uint32_t* s) {
+    uint32_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+int32_t searchScore(CPUState* state) {
+    if (!gamePlaying(state))
+        return gameScore(state, 0);
+    int ships = shipsLeft(state) + (state->mem[RAM_PLAYER_ALIVE] == 0xff);
+    return gameScore(state, 0) + SHIP_VALUE * ships;
+}
+
+static int hold(Search* s, CPUState* cpu, uint8_t action) {
+    setAction(cpu, action);
+    for (int f = 0; f < s->config.frameSkip; f++)
+        runFrameWith(cpu, s->config.step);
+    return s->config.frameSkip;
+}
+
+// mean score of random playouts from the state in cpu, which they use up
+static int32_t rollout(Search* s, CPUState* cpu, SaveState* from, uint32_t seed, uint64_t* frames) {
+    int64_t total = 0;
+    for (int r = 0; r < s->config.rollouts; r++) {
+        uint32_t rng = (seed + r) * 2654435761u | 1;
+        if (r > 0)
+            loadState(cpu, from);
+        for (int i = 0; i < s->config.rolloutDepth && gamePlaying(cpu); i++)
+            *frames += hold(s, cpu, xorshift(&rng) % ACTION_COUNT);
+        total += s->config.score(cpu);
+    }
+    return total / s->config.rollouts;
+}
+
+// where child k sits in the tree, earlier depths and lower numbers first
+static inline uint64_t childTag(Search* s, int k) {
+    return (uint64_t) s->depth << 32 | k;
+}
+
+// child k is parent k / ACTION_COUNT played with action k % ACTION_COUNT
+static void expand(Search* s, CPUState* cpu, int k, uint64_t* frames) {
+    SearchNode* parent = &s->frontier[k / ACTION_COUNT];
+    SearchNode* child = &s->children[k];
+    child->parent = k / ACTION_COUNT;
+    child->action = k % ACTION_COUNT;
+
+    // a finished game has nothing to choose, it rides along on NOOP
+    child->valid = !parent->done || child->action == ACTION_NOOP;
+    if (!child->valid)
+        return;
+    if (parent->done) {
+        child->state = parent->state;
+        child->score = parent->score;
+        child->done = 1;
+        return;
+    }
+
+    loadState(cpu, &parent->state);
+    *frames += hold(s, cpu, child->action);
+    saveState(cpu, &child->state);
+    child->done = !gamePlaying(cpu);
+    if (s->table && !child->done) {
+        child->hash = hashState(cpu);
+        recordState(s->table, child->hash, childTag(s, k));
+    }
+}
+
+// runs once every child is expanded, so the table knows each state's owner
+static void score(Search* s, CPUState* cpu, int k, uint64_t* rollouts, uint64_t* frames, uint64_t* duplicates) {
+    SearchNode* child = &s->children[k];
+    if (!child->valid || s->frontier[child->parent].done)
+        return;
+    if (s->table && !child->done && stateOwner(s->table, child->hash) < childTag(s, k)) {
+        child->valid = 0;
+        (*duplicates)++;
+        return;
+    }
+
+    loadState(cpu, &child->state);
+    if (s->config.rollouts > 0 && !child->done) {
+        uint32_t seed = s->config.seed ^ (s->depth * 0x9e3779b9u) ^ (k * 0x85ebca6bu);
+        child->score = rollout(s, cpu, &child->state, seed, frames);
+        *rollouts += s->config.rollouts;
+    } else {
+        child->score = s->config.score(cpu);
+    }
+}
+
+static void* worker(void* arg) {
+    Search* s = ((SearchWorker*) arg)->search;
+    CPUState* cpu = ((SearchWorker*) arg)->cpu;
+    for (;;) {
+        pthread_barrier_wait(&s->start);
+        if (s->quit)
+            return NULL;
+        uint64_t rollouts = 0, frames = 0, duplicates = 0;
+        int k;
+        while ((k = atomic_fetch_add(&s->next, 1)) < s->childCount)
+            expand(s, cpu, k, &frames);
+        pthread_barrier_wait(&s->expanded);
+        while ((k = atomic_fetch_add(&s->nextScore, 1)) < s->childCount)
+            score(s, cpu, k, &rollouts, &frames, &duplicates);
+        atomic_fetch_add(&s->rollouts, rollouts);
+        atomic_fetch_add(&s->frames, frames);
+        atomic_fetch_add(&s->duplicates, duplicates);
+        pthread_barrier_wait(&s->finish);
+    }
+}
+
+Search* initializeSearch(CPUState* root, SearchConfig* config) {
+    Search* s = calloc(1, sizeof(Search));
+    s->config = *config;
+    SearchConfig* c = &s->config;
+    if (c->frameSkip < 1)
+        c->frameSkip = 1;
+    if (c->depth < 1)
+        c->depth = 1;
+    if (c->threads < 1)
+        c->threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (c->score == NULL)
+        c->score = searchScore;
+    if (c->step == NULL)
+        c->step = stepMachine;
+
+    // the frontier and its children are all that grows with width
+    if (c->memoryCap > 0) {
+        size_t fits = c->memoryCap / ((1 + ACTION_COUNT) * sizeof(SearchNode));
+        if ((size_t) c->width > fits)
+            c->width = fits;
+    }
+    if (c->width < 1)
+        c->width = 1;
+
+    s->frontier = malloc(c->width * sizeof(SearchNode));
+    s->children = malloc(c->width * ACTION_COUNT * sizeof(SearchNode));
+    s->parents = malloc((size_t) c->depth * c->width * sizeof(uint32_t));
+    s->path = malloc((size_t) c->depth * c->width);
+    s->best = malloc(c->depth);
+    if (c->tableBytes > 0)
+        s->table = initializeTable(c->tableBytes);
+
+    saveState(root, &s->root.state);
+    s->root.score = c->score(root);
+    s->root.done = !gamePlaying(root);
+    s->root.valid = 1;
+
+    // every worker gets its own copy of the ROM and the root's memory, a cache line apart
+    s->pool = initializePool(c->threads, root);
+    s->workers = calloc(c->threads, sizeof(SearchWorker));
+    s->threads = malloc(c->threads * sizeof(pthread_t));
+    pthread_barrier_init(&s->start, NULL, c->threads + 1);
+    pthread_barrier_init(&s->expanded, NULL, c->threads + 1);
+    pthread_barrier_init(&s->finish, NULL, c->threads + 1);
+    for (int i = 0; i < c->threads; i++) {
+        SearchWorker* w = &s->workers[i];
+        w->search = s;
+        w->cpu = acquireInstance(s->pool);
+        pthread_create(&s->threads[i], NULL, worker, w);
+    }
+    return s;
+}
+
+void freeSearch(Search* s) {
+    s->quit = 1;
+    pthread_barrier_wait(&s->start);
+    for (int i = 0; i < s->config.threads; i++)
+        pthread_join(s->threads[i], NULL);
+    freePool(s->pool);
+    pthread_barrier_destroy(&s->start);
+    pthread_barrier_destroy(&s->expanded);
+    pthread_barrier_destroy(&s->finish);
+    free(s->threads);
+    free(s->workers);
+    free(s->frontier);
+    free(s->children);
+    free(s->parents);
+    free(s->path);
+    free(s->best);
+    if (s->table)
+        freeTable(s->table);
+    free(s);
+}
+
+// best score first, ties to the lower index so the order never depends on timing
+static int byScore(const void* a, const void* b) {
+    const Ranked* x = a;
+    const Ranked* y = b;
+    if (x->score != y->score)
+        return x->score < y->score ? 1 : -1;
+    return x->index - y->index;
+}
+
+void runSearch(Search* s, SearchResult* result) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int width = s->config.width;
+    Ranked* order = malloc(width * ACTION_COUNT * sizeof(Ranked));
+    uint64_t nodes = 0;
+    s->frontier[0] = s->root;
+    s->count = 1;
+    atomic_store(&s->rollouts, 0);
+    atomic_store(&s->frames, 0);
+    atomic_store(&s->duplicates, 0);
+    if (s->table)
+        clearTable(s->table);
+
+    for (s->depth = 0; s->depth < s->config.depth; s->depth++) {
+        s->childCount = s->count * ACTION_COUNT;
+        atomic_store(&s->next, 0);
+        atomic_store(&s->nextScore, 0);
+        pthread_barrier_wait(&s->start);
+        pthread_barrier_wait(&s->expanded);
+        pthread_barrier_wait(&s->finish);
+
+        int valid = 0;
+        for (int k = 0; k < s->childCount; k++) {
+            if (s->children[k].valid)
+                order[valid++] = (Ranked) { s->children[k].score, k };
+        }
+        nodes += valid;
+        qsort(order, valid, sizeof(Ranked), byScore);
+
+        s->count = valid < width ? valid : width;
+        for (int i = 0; i < s->count; i++) {
+            SearchNode* child = &s->children[order[i].index];
+            s->frontier[i] = *child;
+            s->parents[s->depth * width + i] = child->parent;
+            s->path[s->depth * width + i] = child->action;
+        }
+    }
+
+    // the frontier is sorted, walk back from its head
+    int node = 0;
+    for (int d = s->config.depth - 1; d >= 0; d--) {
+        s->best[d] = s->path[d * width + node];
+        node = s->parents[d * width + node];
+    }
+    free(order);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    result->actions = s->best;
+    result->length = s->config.depth;
+    result->score = s->frontier[0].score;
+    result->duplicates = atomic_load(&s->duplicates);
+    result->nodes = nodes + result->duplicates;
+    result->rollouts = atomic_load(&s->rollouts);
+    result->frames = atomic_load(&s->frames);
+    result->secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+}
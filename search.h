@@ -0,0 +1,100 @@
+#ifndef __search_h__
+#define __search_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "cpu.h"
+#include "machine.h"
+#include "statehash.h"
+
+// higher is better, read from the machine after an action
+typedef int32_t (*ScoreFn)(CPUState* state);
+
+typedef struct SearchConfig {
+    int width;              // nodes kept per depth
+    int depth;              // actions in a sequence
+    int frameSkip;          // frames each action is held for
+    int rollouts;           // random playouts averaged per child, 0 scores the child itself
+    int rolloutDepth;       // actions per playout
+    int threads;            // workers, defaults to the number of CPUs
+    size_t memoryCap;       // bytes for frontier and children, width is cut to fit
+    size_t tableBytes;      // transposition table, 0 plays out duplicate states too
+    uint32_t seed;
+    ScoreFn score;          // searchScore when NULL
+    StepFn step;            // core to run, stepMachine when NULL
+} SearchConfig;
+
+// a machine in the tree, states are copied in and out of the workers' CPUs
+typedef struct SearchNode {
+    SaveState state;
+    int32_t score;
+    uint64_t hash;          // hashState after the action, when there's a table
+    uint32_t parent;        // index in the previous depth's frontier
+    uint8_t action;
+    uint8_t done;           // game over, the node isn't expanded again
+    uint8_t valid;          // 0 for the children a finished parent doesn't get
+} SearchNode;
+
+typedef struct SearchResult {
+    uint8_t* actions;       // best sequence found, length entries, owned by the search
+    int length;
+    int32_t score;
+    uint64_t nodes;         // children expanded
+    uint64_t rollouts;
+    uint64_t duplicates;    // children dropped for reaching a state already in the tree
+    uint64_t frames;        // every frame emulated, expansions and playouts
+    double secs;
+} SearchResult;
+
+/*
+    Beam search over player 1's inputs. Each depth expands every frontier
+    node by every action on a pool of worker threads, each worker cloning
+    nodes in and out of its own CPU with loadState and saveState, so the
+    ROM is loaded once per worker. The best width children by score become
+    the next frontier. With rollouts each child is scored by the mean of
+    random playouts from it, a flat Monte Carlo estimate that looks past
+    the beam's horizon. Children are numbered, and the playouts seeded, by
+    their place in the tree, so results don't depend on the thread count.
+
+    With a table, every child is played and hashed before any is scored,
+    and only the first by that numbering, earlier depths first, of the
+    children reaching a state is kept; the rest are dropped without their
+    playouts. A table too small to hold every state makes the result
+    depend on the thread count again.
+*/
+typedef struct Search {
+    SearchConfig config;
+    SearchNode root;
+    SearchNode* frontier;
+    SearchNode* children;
+    int count;              // nodes in the frontier
+    int childCount;
+    uint32_t* parents;      // depth * width, the path back from each frontier node
+    uint8_t* path;
+    uint8_t* best;
+    int depth;              // depth being expanded
+
+    pthread_t* threads;
+    struct InstancePool* pool;  // the workers' CPUs
+    struct SearchWorker* workers;
+    TranspositionTable* table;
+    pthread_barrier_t start, expanded, finish;
+    atomic_int next;        // next child to expand
+    atomic_int nextScore;   // next child to score
+    atomic_ullong rollouts, frames, duplicates;
+    int quit;
+} Search;
+
+// points, plus a bonus for every ship still in hand
+int32_t searchScore(CPUState* state);
+
+// the tree grows from a copy of root, which is left alone
+Search* initializeSearch(CPUState* root, SearchConfig* config);
+void    freeSearch(Search* search);
+
+// searches from the root again, result->score is the best node's score or playout mean
+void    runSearch(Search* search, SearchResult* result);
+
+#endif
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include "cpu.h"
+#include "machine.h"
+#include "sound.h"
+
+#define AMP_ENABLE 0x20     // port 3 bit 5, the game mutes everything with it
+
+// slot each latch bit starts, -1 for bits that aren't sounds
+static const int8_t port3Slots[8] = { SND_UFO, SND_SHOT, SND_PLAYER_DIE, SND_INVADER_DIE, SND_EXTRA_LIFE, -1, -1, -1 };
+static const int8_t port5Slots[8] = { SND_FLEET1, SND_FLEET2, SND_FLEET3, SND_FLEET4, SND_UFO_HIT, -1, -1, -1 };
+
+static uint32_t noiseSeed = 1;
+
+static int16_t noise() {
+    noiseSeed = noiseSeed * 1103515245 + 12345;
+    return (int16_t) (noiseSeed >> 16);
+}
+
+static Sample blank(double secs) {
+    Sample s;
+    s.length = secs * SOUND_RATE;
+    s.data = calloc(s.length, sizeof(int16_t));
+    return s;
+}
+
+// square wave sliding from f0 to f1 with a linear fade out
+static Sample tone(double secs, double f0, double f1, double amp) {
+    Sample s = blank(secs);
+    double phase = 0;
+    for (int i = 0; i < s.length; i++) {
+        double t = (double) i / s.length;
+        phase += (f0 + (f1 - f0) * t) / SOUND_RATE;
+        s.data[i] = (phase - floor(phase) < 0.5 ? amp : -amp) * (1 - t);
+    }
+    return s;
+}
+
+static Sample burst(double secs, double amp) {
+    Sample s = blank(secs);
+    for (int i = 0; i < s.length; i++) {
+        double fade = 1 - (double) i / s.length;
+        s.data[i] = noise() * amp * fade * fade;
+    }
+    return s;
+}
+
+// stand-ins for when there are no recorded samples, roughly the right character
+static Sample synthesize(int slot) {
+    switch (slot) {
+        case SND_UFO: {
+            Sample s = blank(0.2);
+            double phase = 0;
+            for (int i = 0; i < s.length; i++) {
+                phase += (600 + 200 * sin(2 * M_PI * 10 * i / SOUND_RATE)) / SOUND_RATE;
+                s.data[i] = (phase - floor(phase) < 0.5 ? 0.2 : -0.2) * 32767;
+            }
+            return s;
+        }
+        case SND_SHOT: return tone(0.2, 1200, 300, 0.2 * 32767);
+        case SND_PLAYER_DIE: return burst(1.0, 0.5);
+        case SND_INVADER_DIE: return burst(0.15, 0.4);
+        case SND_FLEET1: return tone(0.1, 110, 110, 0.3 * 32767);
+        case SND_FLEET2: return tone(0.1, 98, 98, 0.3 * 32767);
+        case SND_FLEET3: return tone(0.1, 87, 87, 0.3 * 32767);
+        case SND_FLEET4: return tone(0.1, 82, 82, 0.3 * 32767);
+        case SND_UFO_HIT: return tone(0.5, 1600, 200, 0.25 * 32767);
+        default: return tone(0.4, 1800, 1800, 0.15 * 32767);
+    }
+}
+
+static uint32_t le(uint8_t* p, int bytes) {
+    uint32_t x = 0;
+    for (int i = bytes - 1; i >= 0; i--)
+        x = x << 8 | p[i];
+    return x;
+}
+
+// 8 or 16 bit PCM, channels averaged and resampled to SOUND_RATE
+static int loadWav(const char* path, Sample* out) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+        return 0;
+    fseek(fp, 0L, SEEK_END);
+    long fsize = ftell(fp);
+    fseek(fp, 0L, SEEK_SET);
+    uint8_t* file = malloc(fsize);
+    fread(file, 1, fsize, fp);
+    fclose(fp);
+
+    int ok = 0, channels = 0, rate = 0, bits = 0;
+    if (fsize > 12 && memcmp(file, "RIFF", 4) == 0 && memcmp(file + 8, "WAVE", 4) == 0) {
+        long pos = 12;
+        while (pos + 8 <= fsize) {
+            uint32_t size = le(file + pos + 4, 4);
+            uint8_t* body = file + pos + 8;
+            if (pos + 8 + size > (uint32_t) fsize)
+                size = fsize - pos - 8;
+            if (memcmp(file + pos, "fmt ", 4) == 0 && size >= 16) {
+                channels = le(body + 2, 2);
+                rate = le(body + 4, 4);
+                bits = le(body + 14, 2);
+            } else if (memcmp(file + pos, "data", 4) == 0 && channels > 0 && rate > 0
+                    && (bits == 8 || bits == 16)) {
+                int frameBytes = channels * bits / 8;
+                int frames = size / frameBytes;
+                out->length = (long) frames * SOUND_RATE / rate;
+                out->data = malloc(out->length * sizeof(int16_t));
+                for (int i = 0; i < out->length; i++) {
+                    uint8_t* f = body + (long) i * rate / SOUND_RATE * frameBytes;
+                    int sum = 0;
+                    for (int c = 0; c < channels; c++)
+                        sum += bits == 8 ? (f[c] - 128) << 8 : (int16_t) le(f + c * 2, 2);
+                    out->data[i] = sum / channels;
+                }
+                ok = 1;
+                break;
+            }
+            pos += 8 + size + (size & 1);
+        }
+    }
+    free(file);
+    return ok;
+}
+
+Sound* initializeSound(const char* dir) {
+    Sound* snd = calloc(1, sizeof(Sound));
+    for (int i = 0; i < SND_COUNT; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%d.wav", dir ? dir : ".", i);
+        if (dir == NULL || !loadWav(path, &snd->bank[i]))
+            snd->bank[i] = synthesize(i);
+        snd->position[i] = -1;
+    }
+    snd->maxQueued = SOUND_FRAME_SAMPLES * 3;
+    atomic_init(&snd->ring.head, 0);
+    atomic_init(&snd->ring.tail, 0);
+    return snd;
+}
+
+void freeSound(Sound* snd) {
+    closeWav(snd);
+    for (int i = 0; i < SND_COUNT; i++)
+        free(snd->bank[i].data);
+    free(snd);
+}
+
+static void latch(Sound* snd, uint8_t rising, uint8_t level, const int8_t* slots) {
+    for (int bit = 0; bit < 8; bit++) {
+        int slot = slots[bit];
+        if (slot < 0)
+            continue;
+        if (rising & (1 << bit))
+            snd->position[slot] = 0;
+        // the UFO hum lasts exactly as long as its bit
+        if (slot == SND_UFO && !(level & (1 << bit)))
+            snd->position[slot] = -1;
+    }
+}
+
+// drops what doesn't fit rather than wait, the consumer pads the gap
+static void pushRing(Sound* snd) {
+    AudioRing* ring = &snd->ring;
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    int room = snd->maxQueued - (int) (head - tail);
+    int n = room < SOUND_FRAME_SAMPLES ? (room < 0 ? 0 : room) : SOUND_FRAME_SAMPLES;
+    for (int i = 0; i < n; i++)
+        ring->data[(head + i) & (SOUND_RING - 1)] = snd->mix[i];
+    atomic_store_explicit(&ring->head, head + n, memory_order_release);
+    snd->dropped += SOUND_FRAME_SAMPLES - n;
+}
+
+void soundFrame(Sound* snd, CPUState* state) {
+    latch(snd, state->ports.rising3, state->ports.write3, port3Slots);
+    latch(snd, state->ports.rising5, state->ports.write5, port5Slots);
+    state->ports.rising3 = 0;
+    state->ports.rising5 = 0;
+
+    int32_t acc[SOUND_FRAME_SAMPLES] = { 0 };
+    for (int v = 0; v < SND_COUNT; v++) {
+        Sample* s = &snd->bank[v];
+        int pos = snd->position[v];
+        if (pos < 0 || s->length == 0)
+            continue;
+        for (int i = 0; i < SOUND_FRAME_SAMPLES; i++) {
+            if (pos >= s->length) {
+                if (v != SND_UFO) {
+                    pos = -1;
+                    break;
+                }
+                pos = 0;
+            }
+            acc[i] += s->data[pos++];
+        }
+        snd->position[v] = pos;
+    }
+
+    int muted = !(state->ports.write3 & AMP_ENABLE);
+    for (int i = 0; i < SOUND_FRAME_SAMPLES; i++) {
+        int32_t x = muted ? 0 : acc[i];
+        snd->mix[i] = x > 32767 ? 32767 : x < -32768 ? -32768 : x;
+    }
+
+    if (snd->queue)
+        pushRing(snd);
+    if (snd->wav) {
+        fwrite(snd->mix, sizeof(int16_t), SOUND_FRAME_SAMPLES, snd->wav);
+        snd->wavSamples += SOUND_FRAME_SAMPLES;
+    }
+}
+
+int readSound(AudioRing* ring, int16_t* out, int count) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    int n = head - tail < (unsigned) count ? (int) (head - tail) : count;
+    for (int i = 0; i < n; i++)
+        out[i] = ring->data[(tail + i) & (SOUND_RING - 1)];
+    memset(out + n, 0, (count - n) * sizeof(int16_t));
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+    return n;
+}
+
+static void putLe(FILE* fp, uint32_t x, int bytes) {
+    for (int i = 0; i < bytes; i++)
+        fputc((x >> (8 * i)) & 0xff, fp);
+}
+
+static void wavHeader(Sound* snd) {
+    uint32_t data = snd->wavSamples * 2;
+    fwrite("RIFF", 1, 4, snd->wav);
+    putLe(snd->wav, 36 + data, 4);
+    fwrite("WAVEfmt ", 1, 8, snd->wav);
+    putLe(snd->wav, 16, 4);
+    putLe(snd->wav, 1, 2);              // PCM
+    putLe(snd->wav, 1, 2);              // mono
+    putLe(snd->wav, SOUND_RATE, 4);
+    putLe(snd->wav, SOUND_RATE * 2, 4);
+    putLe(snd->wav, 2, 2);
+    putLe(snd->wav, 16, 2);
+    fwrite("data", 1, 4, snd->wav);
+    putLe(snd->wav, data, 4);
+}
+
+int openWav(Sound* snd, const char* path) {
+    snd->wav = fopen(path, "wb");
+    if (snd->wav == NULL)
+        return 0;
+    snd->wavSamples = 0;
+    wavHeader(snd);
+    return 1;
+}
+
+// sizes are only known at the end, so the header is written again
+void closeWav(Sound* snd) {
+    if (snd->wav == NULL)
+        return;
+    fseek(snd->wav, 0L, SEEK_SET);
+    wavHeader(snd);
+    fclose(snd->wav);
+    snd->wav = NULL;
+}
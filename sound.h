@@ -0,0 +1,74 @@
+#ifndef __sound_h__
+#define __sound_h__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "cpu.h"
+#include "machine.h"
+
+#define SOUND_RATE 44100
+#define SOUND_FRAME_SAMPLES (SOUND_RATE / FRAME_HZ)
+#define SOUND_RING 4096     // samples, a power of two, about 90ms
+
+// sample slots, numbered like the usual invaders sample sets (0.wav .. 9.wav)
+enum {
+    SND_UFO,            // port 3 bit 0, loops while held
+    SND_SHOT,           // port 3 bit 1
+    SND_PLAYER_DIE,     // port 3 bit 2
+    SND_INVADER_DIE,    // port 3 bit 3
+    SND_FLEET1,         // port 5 bits 0..3, the four march notes
+    SND_FLEET2,
+    SND_FLEET3,
+    SND_FLEET4,
+    SND_UFO_HIT,        // port 5 bit 4
+    SND_EXTRA_LIFE,     // port 3 bit 4
+    SND_COUNT
+};
+
+typedef struct Sample {
+    int16_t* data;
+    int length;
+} Sample;
+
+// single producer, single consumer, neither side ever blocks
+typedef struct AudioRing {
+    int16_t data[SOUND_RING];
+    atomic_uint head;   // only the producer writes this
+    atomic_uint tail;   // only the consumer writes this
+} AudioRing;
+
+/*
+    Turns the sound latches on ports 3 and 5 into 16 bit mono audio, one
+    video frame at a time on the emulation thread. Nothing here knows
+    about SDL: a frontend drains ring from its audio callback, a headless
+    run writes the mix to a WAV file.
+*/
+typedef struct Sound {
+    Sample bank[SND_COUNT];
+    int position[SND_COUNT];    // -1 when the voice is idle
+    int16_t mix[SOUND_FRAME_SAMPLES];
+
+    int queue;                  // push each frame into ring
+    int maxQueued;              // latency bound in samples
+    AudioRing ring;
+    uint32_t dropped;           // samples the ring had no room for
+
+    FILE* wav;
+    uint32_t wavSamples;
+} Sound;
+
+// loads dir/N.wav for each slot when dir is given, missing ones are synthesized
+Sound*  initializeSound(const char* dir);
+void    freeSound(Sound* snd);
+
+// starts and stops voices from the port edges, mixes one frame and hands it on
+void    soundFrame(Sound* snd, CPUState* state);
+
+// consumer side, pads with silence when the ring runs dry, returns samples that were real
+int     readSound(AudioRing* ring, int16_t* out, int count);
+
+int     openWav(Sound* snd, const char* path);
+void    closeWav(Sound* snd);
+
+#endif
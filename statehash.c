@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "cpu.h"
+#include "machine.h"
+#include "statehash.h"
+
+#define GOLDEN 0x9e3779b97f4a7c15ull
+#define MIX 0xff51afd7ed558ccdull
+#define PROBES 16
+
+typedef uint64_t lanes __attribute__((vector_size(32)));
+
+// murmur3's finalizer
+static inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= MIX;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t rotl(uint64_t x, int n) {
+    return x << n | x >> (64 - n);
+}
+
+uint64_t hashState(CPUState* state) {
+    syncFlags(state);
+    const uint8_t* ram = &state->mem[RAM_START];
+    lanes acc = {0};
+    lanes key = { GOLDEN, 2 * GOLDEN, 3 * GOLDEN, 4 * GOLDEN };
+    for (int i = 0; i < RAM_SIZE; i += sizeof(lanes)) {
+        lanes word;
+        memcpy(&word, ram + i, sizeof(lanes));
+        lanes x = (word ^ key) * MIX;
+        acc += x ^ x >> 32;
+        key += 4 * GOLDEN;
+    }
+
+    FlagRegister f = state->flags;
+    uint64_t regs = state->b | state->c << 8 | state->d << 16 | (uint64_t) state->e << 24 |
+        (uint64_t) state->h << 32 | (uint64_t) state->l << 40 | (uint64_t) state->a << 48 |
+        (uint64_t) (f.c | f.p << 1 | f.ac << 2 | f.z << 3 | f.s << 4) << 56;
+    uint64_t more = state->pc | (uint64_t) state->sp << 16 | (uint64_t) state->ports.read3 << 32 |
+        (uint64_t) state->ports.write2 << 48 | (uint64_t) state->int_enable << 56;
+    uint64_t ports = state->ports.read1 | state->ports.read2 << 8 | state->ports.write3 << 16 |
+        (uint64_t) state->ports.write5 << 24 | (uint64_t) state->ports.write4 << 32;
+
+    uint64_t h = acc[0] ^ rotl(acc[1], 16) ^ rotl(acc[2], 32) ^ rotl(acc[3], 48);
+    h = avalanche(h ^ regs) + avalanche(more ^ GOLDEN) * MIX + avalanche(ports);
+    return avalanche(h);
+}
+
+TranspositionTable* initializeTable(size_t bytes) {
+    uint64_t slots = 1024;
+    while (slots * 2 * 2 * sizeof(uint64_t) <= bytes)
+        slots *= 2;
+    TranspositionTable* table = calloc(1, sizeof(TranspositionTable));
+    table->keys = malloc(slots * sizeof(uint64_t));
+    table->tags = malloc(slots * sizeof(uint64_t));
+    table->mask = slots - 1;
+    clearTable(table);
+    return table;
+}
+
+void freeTable(TranspositionTable* table) {
+    free(table->keys);
+    free(table->tags);
+    free(table);
+}
+
+// not safe against concurrent records, it's for between searches
+void clearTable(TranspositionTable* table) {
+    for (uint64_t i = 0; i <= table->mask; i++) {
+        atomic_init(&table->keys[i], 0);
+        atomic_init(&table->tags[i], TABLE_ABSENT);
+    }
+    atomic_store(&table->dropped, 0);
+}
+
+int recordState(TranspositionTable* table, uint64_t key, uint64_t tag) {
+    key += !key;
+    for (int p = 0; p < PROBES; p++) {
+        uint64_t i = (key + p) & table->mask;
+        uint64_t found = atomic_load(&table->keys[i]);
+        if (found == 0) {
+            uint64_t empty = 0;
+            if (atomic_compare_exchange_strong(&table->keys[i], &empty, key))
+                found = key;
+            else
+                found = empty;
+        }
+        if (found != key)
+            continue;
+        uint64_t lowest = atomic_load(&table->tags[i]);
+        while (tag < lowest && !atomic_compare_exchange_weak(&table->tags[i], &lowest, tag))
+            ;
+        return 1;
+    }
+    atomic_fetch_add(&table->dropped, 1);
+    return 0;
+}
+
+uint64_t stateOwner(TranspositionTable* table, uint64_t key) {
+    key += !key;
+    for (int p = 0; p < PROBES; p++) {
+        uint64_t i = (key + p) & table->mask;
+        uint64_t found = atomic_load(&table->keys[i]);
+        if (found == key)
+            return atomic_load(&table->tags[i]);
+        if (found == 0)
+            return TABLE_ABSENT;
+    }
+    return TABLE_ABSENT;
+}
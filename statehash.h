@@ -0,0 +1,46 @@
+#ifndef __statehash_h__
+#define __statehash_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "cpu.h"
+
+// lookup result for a key that isn't in the table
+#define TABLE_ABSENT UINT64_MAX
+
+/*
+    64 bit hash of everything a frame's future depends on: registers,
+    flags, interrupt enable, the ports the ROM reads back and all 8KB of
+    RAM. The RAM goes through a vector loop, each 64 bit word keyed by
+    its position, mixed and summed, so the same bytes in another place
+    hash differently and it's well under a microsecond.
+*/
+uint64_t    hashState(CPUState* state);
+
+/*
+    Fixed size open addressing table of state hashes shared by threads
+    without a lock. Each key holds the lowest tag anyone has recorded for
+    it, so once every thread has recorded the owner of a state is the
+    same however they raced. A key that finds no slot within a short
+    probe isn't stored and is counted in dropped.
+*/
+typedef struct TranspositionTable {
+    _Atomic uint64_t* keys;     // 0 is an empty slot
+    _Atomic uint64_t* tags;
+    uint64_t mask;
+    atomic_ullong dropped;
+} TranspositionTable;
+
+// a power of two slots fitting in bytes
+TranspositionTable* initializeTable(size_t bytes);
+void                freeTable(TranspositionTable* table);
+void                clearTable(TranspositionTable* table);
+
+// returns 0 if the table had no room for key
+int                 recordState(TranspositionTable* table, uint64_t key, uint64_t tag);
+
+// lowest tag recorded for key, TABLE_ABSENT if none was
+uint64_t            stateOwner(TranspositionTable* table, uint64_t key);
+
+#endif
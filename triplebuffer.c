@@ -0,0 +1,28 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "triplebuffer.h"
+
+void initializeTripleBuffer(TripleBuffer* tb) {
+    memset(tb->frames, 0, sizeof(tb->frames));
+    tb->back = 0;
+    tb->front = 1;
+    atomic_init(&tb->middle, 2);
+}
+
+uint8_t* backFrame(TripleBuffer* tb) {
+    return tb->frames[tb->back];
+}
+
+void publishFrame(TripleBuffer* tb) {
+    int old = atomic_exchange(&tb->middle, tb->back | TRIPLE_FRESH);
+    tb->back = old & 3;
+}
+
+uint8_t* latestFrame(TripleBuffer* tb, int* fresh) {
+    *fresh = (atomic_load(&tb->middle) & TRIPLE_FRESH) != 0;
+    if (*fresh) {
+        int old = atomic_exchange(&tb->middle, tb->front);
+        tb->front = old & 3;
+    }
+    return tb->frames[tb->front];
+}
@@ -0,0 +1,32 @@
+#ifndef __triplebuffer_h__
+#define __triplebuffer_h__
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "machine.h"
+
+/*
+    Hands finished frames from the emulation thread to the render thread
+    without locks. The producer fills back, the consumer reads front, and
+    the two swap through middle with a single atomic exchange each. Neither
+    side ever waits; the renderer just sees the newest frame.
+*/
+typedef struct TripleBuffer {
+    uint8_t frames[3][VRAM_SIZE];
+    int back;               // producer only
+    int front;              // consumer only
+    atomic_int middle;      // index of the spare, TRIPLE_FRESH set when unread
+} TripleBuffer;
+
+#define TRIPLE_FRESH 4
+
+void        initializeTripleBuffer(TripleBuffer* tb);
+
+// producer: buffer to fill, then publish it
+uint8_t*    backFrame(TripleBuffer* tb);
+void        publishFrame(TripleBuffer* tb);
+
+// consumer: newest published frame, fresh is set if it wasn't seen before
+uint8_t*    latestFrame(TripleBuffer* tb, int* fresh);
+
+#endif
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "machine.h"
+#include "video.h"
+
+#define DELTA_MAGIC "SIDELTA1"
+
+// VRAM columns run bottom to top, each byte holds 8 pixels with bit 0 lowest
+static void rotate(uint8_t* vram, uint8_t* image) {
+    for (int x = 0; x < VIDEO_WIDTH; x++) {
+        for (int j = 0; j < VIDEO_HEIGHT / 8; j++) {
+            uint8_t b = vram[x * 32 + j];
+            for (int bit = 0; bit < 8; bit++) {
+                int y = VIDEO_HEIGHT - 1 - (j * 8 + bit);
+                image[y * VIDEO_WIDTH + x] = (b >> bit) & 1 ? 255 : 0;
+            }
+        }
+    }
+}
+
+/*
+    Per frame: u16 byte count, then runs of (skip u16, length u16, XOR
+    bytes) in VRAM order. An unchanged frame is just a zero count.
+*/
+static int encodeDelta(uint8_t* vram, uint8_t* prev, uint8_t* out) {
+    int n = 2, i = 0, skip = 0;
+    while (i < VRAM_SIZE) {
+        if (vram[i] == prev[i]) {
+            skip++;
+            i++;
+            continue;
+        }
+        int start = i;
+        while (i < VRAM_SIZE && vram[i] != prev[i])
+            i++;
+        int len = i - start;
+        out[n++] = skip & 0xff;
+        out[n++] = skip >> 8;
+        out[n++] = len & 0xff;
+        out[n++] = len >> 8;
+        for (int j = start; j < i; j++)
+            out[n++] = vram[j] ^ prev[j];
+        skip = 0;
+    }
+    out[0] = (n - 2) & 0xff;
+    out[1] = (n - 2) >> 8;
+    return n;
+}
+
+static void writeFrame(VideoWriter* video, uint8_t* vram) {
+    switch (video->format) {
+        case VIDEO_Y4M:
+            rotate(vram, video->image);
+            fputs("FRAME\n", video->out);
+            fwrite(video->image, 1, VIDEO_WIDTH * VIDEO_HEIGHT, video->out);
+            // chroma planes are a constant grey, filled in once when the writer starts
+            fwrite(video->image + VIDEO_WIDTH * VIDEO_HEIGHT, 1, VIDEO_WIDTH * VIDEO_HEIGHT / 2, video->out);
+            break;
+        case VIDEO_RAW:
+            rotate(vram, video->image);
+            fwrite(video->image, 1, VIDEO_WIDTH * VIDEO_HEIGHT, video->out);
+            break;
+        case VIDEO_DELTA: {
+            int n = encodeDelta(vram, video->prev, video->encoded);
+            fwrite(video->encoded, 1, n, video->out);
+            memcpy(video->prev, vram, VRAM_SIZE);
+        } break;
+    }
+    video->frames++;
+}
+
+static void* writerThread(void* arg) {
+    VideoWriter* video = arg;
+    pthread_mutex_lock(&video->lock);
+    for (;;) {
+        while (video->count == 0 && !video->closing)
+            pthread_cond_wait(&video->ready, &video->lock);
+        if (video->count == 0)
+            break;
+
+        // the slot stays ours until count drops, so it's written outside the lock
+        uint8_t* frame = video->queue[video->head];
+        pthread_mutex_unlock(&video->lock);
+        writeFrame(video, frame);
+        pthread_mutex_lock(&video->lock);
+
+        video->head = (video->head + 1) % VIDEO_QUEUE;
+        video->count--;
+        pthread_cond_signal(&video->space);
+    }
+    pthread_mutex_unlock(&video->lock);
+    return NULL;
+}
+
+VideoWriter* openVideo(const char* path, int format) {
+    FILE* out = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (out == NULL)
+        return NULL;
+
+    VideoWriter* video = calloc(1, sizeof(VideoWriter));
+    video->out = out;
+    video->format = format;
+    video->image = malloc(VIDEO_WIDTH * VIDEO_HEIGHT * 3 / 2);
+    video->encoded = malloc(2 + VRAM_SIZE * 5);
+    memset(video->image + VIDEO_WIDTH * VIDEO_HEIGHT, 128, VIDEO_WIDTH * VIDEO_HEIGHT / 2);
+
+    if (format == VIDEO_Y4M) {
+        fprintf(out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", VIDEO_WIDTH, VIDEO_HEIGHT, FRAME_HZ);
+    } else if (format == VIDEO_DELTA) {
+        fputs(DELTA_MAGIC, out);
+    }
+
+    pthread_mutex_init(&video->lock, NULL);
+    pthread_cond_init(&video->ready, NULL);
+    pthread_cond_init(&video->space, NULL);
+    pthread_create(&video->thread, NULL, writerThread, video);
+    return video;
+}
+
+void queueVideoFrame(VideoWriter* video, uint8_t* vram) {
+    pthread_mutex_lock(&video->lock);
+    if (video->count == VIDEO_QUEUE)
+        video->waits++;
+    while (video->count == VIDEO_QUEUE)
+        pthread_cond_wait(&video->space, &video->lock);
+    // head and count move under the writer's feet, so the tail is read here
+    int tail = (video->head + video->count) % VIDEO_QUEUE;
+    pthread_mutex_unlock(&video->lock);
+
+    // only the producer fills slots, and this one is free until count goes up
+    memcpy(video->queue[tail], vram, VRAM_SIZE);
+
+    pthread_mutex_lock(&video->lock);
+    video->count++;
+    pthread_cond_signal(&video->ready);
+    pthread_mutex_unlock(&video->lock);
+}
+
+void closeVideo(VideoWriter* video) {
+    pthread_mutex_lock(&video->lock);
+    video->closing = 1;
+    pthread_cond_signal(&video->ready);
+    pthread_mutex_unlock(&video->lock);
+    pthread_join(video->thread, NULL);
+
+    if (video->out == stdout)
+        fflush(stdout);
+    else
+        fclose(video->out);
+    pthread_mutex_destroy(&video->lock);
+    pthread_cond_destroy(&video->ready);
+    pthread_cond_destroy(&video->space);
+    free(video->image);
+    free(video->encoded);
+    free(video);
+}
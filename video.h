@@ -0,0 +1,56 @@
+#ifndef __video_h__
+#define __video_h__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "machine.h"
+
+#define VIDEO_WIDTH 224     // upright, the monitor is mounted rotated
+#define VIDEO_HEIGHT 256
+#define VIDEO_QUEUE 64      // frames buffered ahead of the writer
+
+enum {
+    VIDEO_Y4M,      // YUV4MPEG2 4:2:0, plays in ffmpeg and mpv
+    VIDEO_RAW,      // 8 bit gray frames back to back
+    VIDEO_DELTA     // 1 bpp VRAM XORed with the previous frame, run length encoded
+};
+
+/*
+    Writes frames from a background thread so headless runs aren't held
+    up by I/O. The emulation thread only copies the 7KB of VRAM into a
+    bounded queue; rotating, expanding and writing happen on the writer.
+    A full queue makes the producer wait rather than lose frames.
+*/
+typedef struct VideoWriter {
+    FILE* out;
+    int format;
+
+    uint8_t queue[VIDEO_QUEUE][VRAM_SIZE];
+    int head;
+    int count;
+    int closing;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;       // a frame was queued or closing was set
+    pthread_cond_t space;       // the writer took a frame
+    pthread_t thread;
+
+    // writer thread only
+    uint8_t prev[VRAM_SIZE];
+    uint8_t* image;
+    uint8_t* encoded;
+
+    uint64_t frames;
+    uint64_t waits;             // times the producer found the queue full
+} VideoWriter;
+
+// path "-" writes to stdout, NULL if the file can't be opened
+VideoWriter*    openVideo(const char* path, int format);
+
+// copies vram into the queue, waits only if the writer is VIDEO_QUEUE frames behind
+void            queueVideoFrame(VideoWriter* video, uint8_t* vram);
+
+// writes out everything queued, then closes the file
+void            closeVideo(VideoWriter* video);
+
+#endif